@@ -0,0 +1,50 @@
+//
+//  ansi.c
+//  TextAppMaker
+//
+
+#include "ansi.h"
+
+#include <stdio.h>
+
+// Palette index to ANSI color number. The palette is in CGA order, where
+// blue and red are swapped relative to ANSI, as are cyan and yellow.
+static const u8 ansi_color[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+static int ColorCode(int color, int base)
+{
+    // Bright colors use the aixterm codes 90-97 and 100-107, which don't
+    // interfere with bold or blink.
+    return (color < 8 ? base : base + 60) + ansi_color[color & 7];
+}
+
+int FormatColors(char * out, u16 cell, int * fg, int * bg)
+{
+    int ch = GET_CHAR(cell);
+    int new_fg = IsBlankGlyph(ch) ? *fg : GET_FG(cell);
+    int new_bg = ch == 219 ? *bg : GET_BG(cell);
+
+    int length = 0;
+    if ( new_fg != *fg && new_bg != *bg ) {
+        length = sprintf(out, "\x1b[%d;%dm", ColorCode(new_fg, 30), ColorCode(new_bg, 40));
+    } else if ( new_fg != *fg ) {
+        length = sprintf(out, "\x1b[%dm", ColorCode(new_fg, 30));
+    } else if ( new_bg != *bg ) {
+        length = sprintf(out, "\x1b[%dm", ColorCode(new_bg, 40));
+    }
+
+    *fg = new_fg;
+    *bg = new_bg;
+    return length;
+}
+
+int FormatCursor(char * out, int x, int y)
+{
+    if ( x == 0 && y == 0 ) {
+        return sprintf(out, "\x1b[H");
+    } else if ( x == 0 ) {
+        return sprintf(out, "\x1b[%dH", y + 1);
+    }
+
+    return sprintf(out, "\x1b[%d;%dH", y + 1, x + 1);
+}
@@ -0,0 +1,35 @@
+//
+//  ansi.h
+//  TextAppMaker
+//
+//  Escape sequences shared by the exporter and the terminal player.
+//  Terminal colors are tracked as palette indices; after a reset they are
+//  assumed to be 7 on 0.
+//
+
+#ifndef ansi_h
+#define ansi_h
+
+#include "common.h"
+#include <stdbool.h>
+
+// Longest sequence the functions below write.
+#define ANSI_MAX_SEQUENCE 16
+
+// Glyphs that only show their background.
+static inline bool IsBlankGlyph(int ch)
+{
+    return ch == 0 || ch == ' ' || ch == 255;
+}
+
+/// Write to `out` the SGR sequence, if any, that a terminal with colors
+/// `fg` and `bg` needs to show `cell`, and update them. A blank glyph
+/// doesn't need its foreground, nor a solid block its background. Returns
+/// the length written.
+int FormatColors(char * out, u16 cell, int * fg, int * bg);
+
+/// Write a sequence moving the cursor to x, y (zero based). Returns the
+/// length written.
+int FormatCursor(char * out, int x, int y);
+
+#endif /* ansi_h */
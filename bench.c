@@ -0,0 +1,622 @@
+//
+//  bench.c
+//  TextAppMaker
+//
+//  Headless benchmarks. Build with every .c file except main.c and tool.c
+//  and link SDL2, e.g.
+//  cc -O2 -o bench $(ls *.c | grep -v -e main.c -e tool.c) `sdl2-config --cflags --libs`
+//
+//  usage: bench io|format|ansi DIR [REPS]
+//         bench suite [REPS [DIR]]
+//
+//  The suite runs each benchmark REPS times and prints the results as JSON.
+//  It uses SDL's dummy video driver, unless SDL_VIDEODRIVER says otherwise,
+//  and the software renderer. Screens in DIR are added to the file tests.
+//
+
+#include "common.h"
+#include "block.h"
+#include "file.h"
+#include "fill.h"
+#include "grid.h"
+#include "import.h"
+#include "map.h"
+#include "render.h"
+#include "text.h"
+#include "undo.h"
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static double Seconds(u64 start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start)
+        / SDL_GetPerformanceFrequency();
+}
+
+static size_t FileSize(const char * path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+#define MAX_FILES 1024
+
+static char paths[MAX_FILES][1024];
+static int num_paths;
+
+// Collect the regular files in `dir` into `paths`.
+static bool ListFiles(const char * dir)
+{
+    DIR * d = opendir(dir);
+    if ( d == NULL ) {
+        printf("Could not open '%s'\n", dir);
+        return false;
+    }
+
+    num_paths = 0;
+    struct dirent * entry;
+    while ( (entry = readdir(d)) && num_paths < MAX_FILES ) {
+        if ( entry->d_name[0] == '.' ) {
+            continue;
+        }
+        snprintf(paths[num_paths], sizeof(paths[0]), "%s/%s", dir, entry->d_name);
+        struct stat st;
+        if ( stat(paths[num_paths], &st) == 0 && S_ISREG(st.st_mode) ) {
+            num_paths++;
+        }
+    }
+    closedir(d);
+
+    if ( num_paths == 0 ) {
+        printf("No files in '%s'\n", dir);
+        return false;
+    }
+
+    return true;
+}
+
+// Load every screen file in `dir` `reps` times with each load path, then save
+// each one back out, and report throughput.
+static int BenchIO(const char * dir, int reps)
+{
+    if ( !ListFiles(dir) ) {
+        return 1;
+    }
+
+    size_t total_bytes = 0;
+    for ( int i = 0; i < num_paths; i++ ) {
+        total_bytes += FileSize(paths[i]);
+    }
+
+    double mb = (double)total_bytes * reps / (1024.0 * 1024.0);
+    int failures = 0;
+
+    for ( int pass = 0; pass < 2; pass++ ) {
+        mmap_threshold = pass == 0 ? 0 : SIZE_MAX;
+
+        u64 start = SDL_GetPerformanceCounter();
+        for ( int r = 0; r < reps; r++ ) {
+            for ( int i = 0; i < num_paths; i++ ) {
+                failures += !LoadFile(paths[i]);
+            }
+        }
+        double t = Seconds(start);
+
+        printf("load (%s): %d files x %d in %.3f s, %.1f MB/s\n",
+               pass == 0 ? "mmap" : "stdio",
+               num_paths,
+               reps,
+               t,
+               mb / t);
+    }
+
+    char out_path[1100];
+    double save_time = 0.0;
+    size_t saved_bytes = 0;
+
+    for ( int i = 0; i < num_paths; i++ ) {
+        if ( !LoadFile(paths[i]) ) {
+            continue;
+        }
+
+        snprintf(out_path, sizeof(out_path), "%.1000s.bench", paths[i]);
+        u64 start = SDL_GetPerformanceCounter();
+        for ( int r = 0; r < reps; r++ ) {
+            failures += !SaveFile(out_path);
+        }
+        save_time += Seconds(start);
+        saved_bytes += FileSize(out_path) * reps;
+        remove(out_path);
+    }
+
+    printf("save (atomic): %d files x %d in %.3f s, %.1f MB/s\n",
+           num_paths,
+           reps,
+           save_time,
+           saved_bytes / (1024.0 * 1024.0) / save_time);
+
+    if ( failures ) {
+        printf("%d operations failed\n", failures);
+    }
+
+    return failures != 0;
+}
+
+// Convert every screen in `dir` to each format and compare file size and
+// load time.
+static int BenchFormat(const char * dir, int reps)
+{
+    if ( !ListFiles(dir) ) {
+        return 1;
+    }
+
+    static const char * names[] = { "legacy", "v2" };
+    size_t sizes[2] = { 0, 0 };
+    double times[2] = { 0.0, 0.0 };
+    int failures = 0;
+    char out_path[1100];
+
+    for ( int i = 0; i < num_paths; i++ ) {
+        if ( !LoadFile(paths[i]) ) {
+            failures++;
+            continue;
+        }
+
+        snprintf(out_path, sizeof(out_path), "%.1000s.bench", paths[i]);
+
+        for ( int format = FORMAT_LEGACY; format <= FORMAT_V2; format++ ) {
+            save_format = format;
+            failures += !SaveFile(out_path);
+            sizes[format] += FileSize(out_path);
+
+            u64 start = SDL_GetPerformanceCounter();
+            for ( int r = 0; r < reps; r++ ) {
+                failures += !LoadFile(out_path);
+            }
+            times[format] += Seconds(start);
+        }
+
+        remove(out_path);
+    }
+
+    for ( int format = FORMAT_LEGACY; format <= FORMAT_V2; format++ ) {
+        printf("%-6s: %zu bytes (%.1f%%), load %.2f us/file\n",
+               names[format],
+               sizes[format],
+               100.0 * sizes[format] / sizes[FORMAT_LEGACY],
+               times[format] * 1e6 / ((double)num_paths * reps));
+    }
+
+    if ( failures ) {
+        printf("%d operations failed\n", failures);
+    }
+
+    return failures != 0;
+}
+
+// Import every ANSI file in `dir` `reps` times and report throughput.
+static int BenchANSI(const char * dir, int reps)
+{
+    if ( !ListFiles(dir) ) {
+        return 1;
+    }
+
+    size_t total_bytes = 0;
+    for ( int i = 0; i < num_paths; i++ ) {
+        total_bytes += FileSize(paths[i]);
+    }
+
+    int failures = 0;
+    u64 start = SDL_GetPerformanceCounter();
+    for ( int r = 0; r < reps; r++ ) {
+        for ( int i = 0; i < num_paths; i++ ) {
+            failures += !ImportANSI(paths[i], NULL);
+        }
+    }
+    double t = Seconds(start);
+
+    printf("import: %d files x %d in %.3f s, %.1f MB/s\n",
+           num_paths,
+           reps,
+           t,
+           (double)total_bytes * reps / (1024.0 * 1024.0) / t);
+
+    if ( failures ) {
+        printf("%d imports failed\n", failures);
+    }
+
+    return failures != 0;
+}
+
+//
+// Suite
+//
+
+#define MAX_REPS 1000
+#define SUITE_FILE "bench-suite.tam"
+#define TEXT_CHARS (80 * 30 * 4)
+
+static int num_results;
+static int suite_failures;
+
+static int CompareDoubles(const void * a, const void * b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Print one benchmark's result as a JSON object. `times` are the seconds each
+// repetition took, each handling `items` of `item`.
+static void Report(const char * name, double items, const char * item, double * times, int reps)
+{
+    double sum = 0.0;
+    for ( int i = 0; i < reps; i++ ) {
+        sum += times[i];
+    }
+    double mean = sum / reps;
+
+    double variance = 0.0;
+    for ( int i = 0; i < reps; i++ ) {
+        variance += (times[i] - mean) * (times[i] - mean);
+    }
+    variance = reps > 1 ? variance / (reps - 1) : 0.0;
+
+    qsort(times, reps, sizeof(*times), CompareDoubles);
+    double median = reps % 2 ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2.0;
+
+    printf("%s\n    { \"name\": \"%s\", \"reps\": %d, \"items\": %.0f, \"item\": \"%s\", "
+           "\"mean_ms\": %.4f, \"stddev_ms\": %.4f, \"min_ms\": %.4f, \"median_ms\": %.4f, "
+           "\"max_ms\": %.4f, \"%s_per_s\": %.1f }",
+           num_results++ ? "," : "",
+           name,
+           reps,
+           items,
+           item,
+           mean * 1000.0,
+           SDL_sqrt(variance) * 1000.0,
+           times[0] * 1000.0,
+           median * 1000.0,
+           times[reps - 1] * 1000.0,
+           item,
+           median > 0.0 ? items / median : 0.0);
+}
+
+// Synthetic screens, w x h, replacing the work area.
+
+static void PaintNoise(int w, int h)
+{
+    ClearMap();
+    u16 row[MAX_WIDTH];
+    for ( int y = 0; y < h; y++ ) {
+        for ( int x = 0; x < w; x++ ) {
+            row[x] = rand();
+        }
+        WriteCells(0, y, w, row);
+    }
+    app_w = w;
+    app_h = h;
+}
+
+// Runs of a few colors and glyphs, like drawn art.
+static void PaintArt(int w, int h)
+{
+    ClearMap();
+    u16 row[MAX_WIDTH];
+    for ( int y = 0; y < h; y++ ) {
+        for ( int x = 0; x < w; ) {
+            u16 cell = (rand() % 4) << 12 | (rand() % 16) << 8 | (rand() % 4 ? 0 : 0xB0 + rand() % 3);
+            for ( int run = 1 + rand() % 16; run > 0 && x < w; run-- ) {
+                row[x++] = cell;
+            }
+        }
+        WriteCells(0, y, w, row);
+    }
+    app_w = w;
+    app_h = h;
+}
+
+static void PaintBlank(int w, int h)
+{
+    ClearMap();
+    app_w = w;
+    app_h = h;
+}
+
+// Walls down every other column with a gap at alternately the bottom and the
+// top: one path that winds through every open cell.
+static void PaintComb(int w, int h)
+{
+    PaintBlank(w, h);
+    for ( int x = 1; x < w; x += 2 ) {
+        int gap = (x / 2) % 2 ? 0 : h - 1;
+        for ( int y = 0; y < h; y++ ) {
+            if ( y != gap ) {
+                SetCell(x, y, 0x07DB);
+            }
+        }
+    }
+}
+
+// Open cells only touch at corners, so an 8-way fill is all one-cell spans.
+static void PaintChecker(int w, int h)
+{
+    PaintBlank(w, h);
+    u16 row[MAX_WIDTH];
+    for ( int y = 0; y < h; y++ ) {
+        for ( int x = 0; x < w; x++ ) {
+            row[x] = (x + y) % 2 ? 0x07DB : 0;
+        }
+        WriteCells(0, y, w, row);
+    }
+}
+
+static void SuiteText(int reps)
+{
+    double times[MAX_REPS];
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+
+    for ( int atlas = 1; atlas >= 0; atlas-- ) {
+        UseGlyphAtlas(atlas);
+        for ( int r = 0; r < reps; r++ ) {
+            u64 start = SDL_GetPerformanceCounter();
+            for ( int i = 0; i < TEXT_CHARS; i++ ) {
+                PrintChar(i % 80 * FONT_W, i / 80 % 30 * FONT_H, i & 0xFF);
+            }
+            SDL_RenderFlush(renderer);
+            times[r] = Seconds(start);
+        }
+        Report(atlas ? "print_char" : "print_char_points", TEXT_CHARS, "chars", times, reps);
+    }
+    UseGlyphAtlas(true);
+
+    char line[81];
+    for ( int i = 0; i < 80; i++ ) {
+        line[i] = 32 + i;
+    }
+    line[80] = '\0';
+
+    for ( int r = 0; r < reps; r++ ) {
+        u64 start = SDL_GetPerformanceCounter();
+        for ( int i = 0; i < TEXT_CHARS / 80; i++ ) {
+            PrintString(0, i % 30 * FONT_H, "%s", line);
+        }
+        SDL_RenderFlush(renderer);
+        times[r] = Seconds(start);
+    }
+    Report("print_string", TEXT_CHARS, "chars", times, reps);
+}
+
+// Recreate the map texture and redraw the whole view into it, as a window
+// resize or backend change does.
+static void SuiteRebuild(int reps)
+{
+    double times[MAX_REPS];
+    PaintNoise(MAX_VIEW_W, MAX_VIEW_H);
+    SetView(0, 0);
+    SDL_Rect dst = { 0, 0, view_w * FONT_W, view_h * FONT_H };
+
+    for ( int b = 0; b < NUM_BACKENDS; b++ ) {
+        SetBackend(b);
+        for ( int r = 0; r < reps; r++ ) {
+            u64 start = SDL_GetPerformanceCounter();
+            RebuildMapTexture();
+            FlushDirty();
+            RenderMap(&dst);
+            SDL_RenderFlush(renderer);
+            times[r] = Seconds(start);
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "rebuild_%s", BackendName(b));
+        Report(name, view_w * view_h, "cells", times, reps);
+    }
+
+    SetBackend(BACKEND_GEOMETRY);
+}
+
+static void SuiteFill(int reps)
+{
+    static const struct {
+        const char * name;
+        void (* paint)(int w, int h);
+        int size;
+        bool diagonal;
+    } cases[] = {
+        { "fill_open_4096", PaintBlank, 4096, false },
+        { "fill_comb_1024", PaintComb, 1024, false },
+        { "fill_checker_8way_1024", PaintChecker, 1024, true },
+    };
+
+    double times[MAX_REPS];
+    for ( int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++ ) {
+        for ( int r = 0; r < reps; r++ ) {
+            cases[i].paint(cases[i].size, cases[i].size);
+            u64 start = SDL_GetPerformanceCounter();
+            FloodFill(0, 0, 0x1F2A, FILL_MATCH_CELL, cases[i].diagonal);
+            times[r] = Seconds(start);
+        }
+        Report(cases[i].name, (double)cases[i].size * cases[i].size, "cells", times, reps);
+    }
+}
+
+static void SuiteFiles(int reps, const char * dir)
+{
+    static const struct {
+        const char * name;
+        void (* paint)(int w, int h);
+        int size;
+    } cases[] = {
+        { "noise_256", PaintNoise, 256 },
+        { "art_256", PaintArt, 256 },
+        { "art_2048", PaintArt, 2048 },
+    };
+
+    double save_times[MAX_REPS];
+    double load_times[MAX_REPS];
+    char name[64];
+
+    for ( int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++ ) {
+        cases[i].paint(cases[i].size, cases[i].size);
+        for ( int r = 0; r < reps; r++ ) {
+            u64 start = SDL_GetPerformanceCounter();
+            suite_failures += !SaveFile(SUITE_FILE);
+            save_times[r] = Seconds(start);
+
+            start = SDL_GetPerformanceCounter();
+            suite_failures += !LoadFile(SUITE_FILE);
+            load_times[r] = Seconds(start);
+        }
+
+        double cells = (double)cases[i].size * cases[i].size;
+        snprintf(name, sizeof(name), "save_%s", cases[i].name);
+        Report(name, cells, "cells", save_times, reps);
+        snprintf(name, sizeof(name), "load_%s", cases[i].name);
+        Report(name, cells, "cells", load_times, reps);
+    }
+
+    if ( dir && ListFiles(dir) ) {
+        for ( int r = 0; r < reps; r++ ) {
+            save_times[r] = 0.0;
+            u64 start = SDL_GetPerformanceCounter();
+            for ( int i = 0; i < num_paths; i++ ) {
+                suite_failures += !LoadFile(paths[i]);
+            }
+            load_times[r] = Seconds(start);
+
+            for ( int i = 0; i < num_paths; i++ ) {
+                if ( LoadFile(paths[i]) ) {
+                    start = SDL_GetPerformanceCounter();
+                    suite_failures += !SaveFile(SUITE_FILE);
+                    save_times[r] += Seconds(start);
+                }
+            }
+        }
+
+        Report("save_dir", num_paths, "files", save_times, reps);
+        Report("load_dir", num_paths, "files", load_times, reps);
+    }
+
+    remove(SUITE_FILE);
+}
+
+static void SuiteBlocks(int reps)
+{
+    double times[4][MAX_REPS];
+    SDL_Rect r = { 0, 0, 1024, 1024 };
+    block_t block = { 0 };
+
+    PaintArt(2048, 2048);
+    for ( int i = 0; i < reps; i++ ) {
+        u64 start = SDL_GetPerformanceCounter();
+        suite_failures += !CopyBlock(&block, r);
+        times[0][i] = Seconds(start);
+
+        start = SDL_GetPerformanceCounter();
+        PasteBlock(&block, 1024, 1024);
+        times[1][i] = Seconds(start);
+
+        start = SDL_GetPerformanceCounter();
+        BeginEdit(EDIT_PASTE, false);
+        PasteBlock(&block, 512, 512);
+        EndEdit();
+        times[2][i] = Seconds(start);
+        ClearUndo();
+
+        start = SDL_GetPerformanceCounter();
+        MoveBlock(r, 7, 5, 0);
+        times[3][i] = Seconds(start);
+    }
+
+    FreeBlock(&block);
+
+    double cells = (double)r.w * r.h;
+    Report("copy_block_1024", cells, "cells", times[0], reps);
+    Report("paste_block_1024", cells, "cells", times[1], reps);
+    Report("paste_block_1024_undo", cells, "cells", times[2], reps);
+    Report("move_block_1024", cells, "cells", times[3], reps);
+}
+
+static int Suite(int reps, const char * dir)
+{
+    reps = MIN(reps, MAX_REPS);
+
+    // No window is ever shown, so no display is needed.
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    if ( SDL_Init(SDL_INIT_VIDEO) != 0 ) {
+        printf("Could not initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    window = SDL_CreateWindow("bench",
+                              SDL_WINDOWPOS_UNDEFINED,
+                              SDL_WINDOWPOS_UNDEFINED,
+                              80 * FONT_W,
+                              30 * FONT_H,
+                              SDL_WINDOW_HIDDEN);
+    if ( window ) {
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE);
+    }
+    if ( renderer == NULL ) {
+        printf("Could not create a software renderer: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    InitText();
+    srand(1);
+
+    SDL_RendererInfo info;
+    SDL_GetRendererInfo(renderer, &info);
+    printf("{\n  \"video_driver\": \"%s\",\n  \"renderer\": \"%s\",\n  \"reps\": %d,\n  \"results\": [",
+           SDL_GetCurrentVideoDriver(),
+           info.name,
+           reps);
+
+    SuiteText(reps);
+    SuiteRebuild(reps);
+    SuiteFill(reps);
+    SuiteFiles(reps, dir);
+    SuiteBlocks(reps);
+
+    printf("\n  ],\n  \"failures\": %d\n}\n", suite_failures);
+
+    FreeMapTexture();
+    FreeGrid();
+    FreeText();
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return suite_failures != 0;
+}
+
+int main(int argc, char ** argv)
+{
+    if ( argc >= 2 && strcmp(argv[1], "suite") == 0 ) {
+        int reps = argc >= 3 ? MAX(atoi(argv[2]), 1) : 10;
+        return Suite(reps, argc >= 4 ? argv[3] : NULL);
+    }
+
+    if ( argc >= 3 ) {
+        int reps = argc >= 4 ? MAX(atoi(argv[3]), 1) : 100;
+
+        if ( strcmp(argv[1], "io") == 0 ) {
+            return BenchIO(argv[2], reps);
+        } else if ( strcmp(argv[1], "format") == 0 ) {
+            return BenchFormat(argv[2], reps);
+        } else if ( strcmp(argv[1], "ansi") == 0 ) {
+            return BenchANSI(argv[2], reps);
+        }
+    }
+
+    printf("usage: %s io|format|ansi DIR [REPS]\n", argv[0]);
+    printf("       %s suite [REPS [DIR]]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,174 @@
+//
+//  block.c
+//  TextAppMaker
+//
+
+#include "block.h"
+#include "map.h"
+
+#include <stdlib.h>
+
+static u16 row[MAX_WIDTH];
+
+static SDL_Rect ClipToMap(SDL_Rect r)
+{
+    int x1 = MAX(r.x, 0);
+    int y1 = MAX(r.y, 0);
+    int x2 = MIN(r.x + r.w, app_w);
+    int y2 = MIN(r.y + r.h, app_h);
+
+    if ( x1 >= x2 || y1 >= y2 ) {
+        return (SDL_Rect){ 0, 0, 0, 0 };
+    }
+
+    return (SDL_Rect){ x1, y1, x2 - x1, y2 - y1 };
+}
+
+bool CopyBlock(block_t * block, SDL_Rect r)
+{
+    r = ClipToMap(r);
+    if ( r.w == 0 ) {
+        return false;
+    }
+
+    if ( r.w * r.h > block->w * block->h ) {
+        u16 * new_cells = realloc(block->cells, r.w * r.h * sizeof(*new_cells));
+        if ( new_cells == NULL ) {
+            printf("Error: out of memory copying %d x %d block\n", r.w, r.h);
+            return false;
+        }
+        block->cells = new_cells;
+    }
+
+    block->w = r.w;
+    block->h = r.h;
+    for ( int y = 0; y < r.h; y++ ) {
+        ReadCells(r.x, r.y + y, r.w, &block->cells[y * r.w]);
+    }
+
+    return true;
+}
+
+void FreeBlock(block_t * block)
+{
+    free(block->cells);
+    *block = (block_t){ 0 };
+}
+
+SDL_Rect PasteBlock(const block_t * block, int x, int y)
+{
+    SDL_Rect r = ClipToMap((SDL_Rect){ x, y, block->w, block->h });
+    if ( r.w == 0 ) {
+        return r;
+    }
+
+    // Offset of the clipped area within the block.
+    const u16 * src = &block->cells[(r.y - y) * block->w + (r.x - x)];
+    for ( int i = 0; i < r.h; i++ ) {
+        WriteCells(r.x, r.y + i, r.w, &src[i * block->w]);
+    }
+
+    MarkDirtyRect(r);
+    return r;
+}
+
+SDL_Rect MoveBlock(SDL_Rect r, int dx, int dy, u16 blank)
+{
+    r = ClipToMap(r);
+    SDL_Rect dst = ClipToMap((SDL_Rect){ r.x + dx, r.y + dy, r.w, r.h });
+    if ( r.w == 0 || (dx == 0 && dy == 0) ) {
+        return r;
+    }
+
+    // Copy rows in the direction that reads each source row before it is
+    // overwritten. Within a row, the whole span is read first.
+    if ( dst.w > 0 ) {
+        int first = dst.y;
+        int last = dst.y + dst.h - 1;
+        int step = 1;
+        if ( dy > 0 ) {
+            first = last;
+            last = dst.y;
+            step = -1;
+        }
+
+        for ( int y = first; y != last + step; y += step ) {
+            ReadCells(dst.x - dx, y - dy, dst.w, row);
+            WriteCells(dst.x, y, dst.w, row);
+        }
+    }
+
+    // Blank what's left of the source: the parts of each row that the
+    // destination did not cover.
+    for ( int i = 0; i < r.w; i++ ) {
+        row[i] = blank;
+    }
+
+    for ( int y = r.y; y < r.y + r.h; y++ ) {
+        if ( dst.w == 0 || y < dst.y || y >= dst.y + dst.h ) {
+            WriteCells(r.x, y, r.w, row);
+            continue;
+        }
+
+        if ( r.x < dst.x ) {
+            WriteCells(r.x, y, MIN(dst.x, r.x + r.w) - r.x, row);
+        }
+
+        int dst_right = dst.x + dst.w;
+        if ( dst_right < r.x + r.w ) {
+            int x = MAX(dst_right, r.x);
+            WriteCells(x, y, r.x + r.w - x, row);
+        }
+    }
+
+    SDL_Rect changed;
+    SDL_UnionRect(&r, &dst, &changed);
+    MarkDirtyRect(dst.w ? changed : r);
+    return dst;
+}
+
+SDL_Rect FillBlock(SDL_Rect r, u16 cell)
+{
+    r = ClipToMap(r);
+
+    for ( int i = 0; i < r.w; i++ ) {
+        row[i] = cell;
+    }
+
+    for ( int y = r.y; y < r.y + r.h; y++ ) {
+        WriteCells(r.x, y, r.w, row);
+    }
+
+    MarkDirtyRect(r);
+    return r;
+}
+
+SDL_Rect RecolorBlock(SDL_Rect r, int fg, int bg)
+{
+    r = ClipToMap(r);
+
+    u16 keep = 0x00FF;
+    u16 set = 0;
+    if ( fg == -1 ) {
+        keep |= 0x0F00;
+    } else {
+        set |= (fg & 0x0F) << 8;
+    }
+
+    if ( bg == -1 ) {
+        keep |= 0xF000;
+    } else {
+        set |= (bg & 0x0F) << 12;
+    }
+
+    for ( int y = r.y; y < r.y + r.h; y++ ) {
+        ReadCells(r.x, y, r.w, row);
+        for ( int i = 0; i < r.w; i++ ) {
+            row[i] = (row[i] & keep) | set;
+        }
+        WriteCells(r.x, y, r.w, row);
+    }
+
+    MarkDirtyRect(r);
+    return r;
+}
@@ -0,0 +1,41 @@
+//
+//  block.h
+//  TextAppMaker
+//
+//  Operations on rectangular areas of the map. Every rectangle is clipped to
+//  the work area first, each row is moved with one ReadCells/WriteCells, and
+//  the changed area is marked dirty as a single rectangle.
+//
+
+#ifndef block_h
+#define block_h
+
+#include "common.h"
+#include <stdbool.h>
+
+typedef struct {
+    u16 * cells;
+    int w;
+    int h;
+} block_t;
+
+/// Copy area `r` of the map into `block`, reusing its buffer. Returns false
+/// if out of memory or `r` is entirely off the map.
+bool CopyBlock(block_t * block, SDL_Rect r);
+void FreeBlock(block_t * block);
+
+/// Write `block` with its top left at x, y, dropping whatever falls off the
+/// map. Returns the area written, which is empty if none of it fits.
+SDL_Rect PasteBlock(const block_t * block, int x, int y);
+
+/// Move area `r` by dx, dy, leaving `blank` where it was. The source and
+/// destination may overlap. Returns the destination area.
+SDL_Rect MoveBlock(SDL_Rect r, int dx, int dy, u16 blank);
+
+/// Set every cell in `r` to `cell`.
+SDL_Rect FillBlock(SDL_Rect r, u16 cell);
+
+/// Change the colors in `r`, keeping the glyphs. A color of -1 is left as is.
+SDL_Rect RecolorBlock(SDL_Rect r, int fg, int bg);
+
+#endif /* block_h */
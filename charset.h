@@ -0,0 +1,21 @@
+//
+//  charset.h
+//  TextAppMaker
+//
+//  Code page 437, the character set of the font, as Unicode. The control
+//  codes 0x01-0x1F and 0x7F map to the symbols the font draws for them, and
+//  the blank glyph 0x00 to a space.
+//
+
+#ifndef charset_h
+#define charset_h
+
+#include "common.h"
+
+extern const u16 cp437_unicode[256];
+
+/// The UTF-8 encoding of CP437 character `ch`, which is `*length` (1-3)
+/// bytes long and not terminated.
+const char * CP437ToUTF8(u8 ch, int * length);
+
+#endif /* charset_h */
@@ -0,0 +1,29 @@
+//
+//  common.c
+//  TextAppMaker
+//
+
+#include "common.h"
+
+SDL_Window * window;
+SDL_Renderer * renderer;
+
+const SDL_Color palette[16] = {
+    { 0x00, 0x00, 0x00 },
+    { 0x00, 0x00, 0xAA },
+//    { 0x04, 0x14, 0x41 }, // Get that funkly blue color!
+    { 0x00, 0xAA, 0x00 },
+    { 0x00, 0xAA, 0xAA },
+    { 0xAA, 0x00, 0x00 },
+    { 0xAA, 0x00, 0xAA },
+    { 0xAA, 0x55, 0x00 },
+    { 0xAA, 0xAA, 0xAA },
+    { 0x55, 0x55, 0x55 },
+    { 0x55, 0x55, 0xFF },
+    { 0x55, 0xFF, 0x55 },
+    { 0x55, 0xFF, 0xFF },
+    { 0xFF, 0x55, 0x55 },
+    { 0xFF, 0x55, 0xFF },
+    { 0xFF, 0xFF, 0x55 },
+    { 0xFF, 0xFF, 0xFF },
+};
@@ -20,7 +20,22 @@ typedef uint16_t    u16;
 typedef uint32_t    u32;
 typedef uint64_t    u64;
 
+#define MAX(a, b) ((a > b) ? (a) : (b))
+#define MIN(a, b) ((a < b) ? (a) : (b))
+#define CLAMP(a, min, max) (a = a < min ? min : a > max ? max : a)
+
+#define FONT_W 8
+#define FONT_H 16
+
+#define GET_FG(x) ((x & 0x0F00) >> 8)
+#define GET_BG(x) ((x & 0xF000) >> 12)
+#define GET_CHAR(x) (x & 0xFF)
+#define SET_FG(x, fg) do { x &= 0xF0FF; x |= fg << 8; } while ( 0 );
+#define SET_BG(x, bg) do { x &= 0x0FFF; x |= bg << 12; } while ( 0 );
+#define SET_CHAR(x, ch) do { x &= 0xFF00; x |= ch; } while ( 0 );
+
 extern SDL_Window * window;
 extern SDL_Renderer * renderer;
+extern const SDL_Color palette[16];
 
 #endif /* common_h */
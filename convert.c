@@ -0,0 +1,870 @@
+//
+//  convert.c
+//  TextAppMaker
+//
+//  For a glyph drawn in fg on bg, a block's error is the sum of each set
+//  pixel's distance to fg plus each clear pixel's distance to bg. The two
+//  halves don't depend on each other, so with the distance of every pixel to
+//  every color summed over the glyph's set pixels (and the rest found from
+//  the totals), the best pair for a glyph is just the smallest of each half:
+//  256 glyphs, not 256 * 16 * 16 candidates. And most glyphs are a few pixels
+//  off some other glyph, or its inverse, so each one's sums are found from
+//  those of its nearest neighbor, with 16-wide adds for the pixels that differ.
+//
+
+#include "convert.h"
+#include "cp437.h"
+#include "map.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#define CONVERT_X86
+#endif
+
+#define BLOCK_PIXELS (FONT_W * FONT_H) // 128: two u64 of mask
+#define MAX_THREADS 64
+#define MAX_IMAGE_SIZE 32768
+
+// A glyph as the pixels that differ from `parent`, an earlier glyph, or its
+// inverse if `flip`.
+typedef struct {
+    u8 ch;
+    int parent;         // -1 for the first, which differs from no pixels set
+    bool flip;
+    int num_add;        // Set here but not in the parent
+    int num_sub;        // Set in the parent but not here
+    u8 pixels[BLOCK_PIXELS]; // The added, then the subtracted
+    u64 mask[2];        // Set pixels
+} glyph_t;
+
+// Only glyphs that look different, even with their colors swapped, need to be
+// tried. Where several look the same the lowest numbered is kept. Ordered so
+// that parents come first.
+static glyph_t glyphs[256];
+static int num_glyphs;
+
+// The squared distance of each pixel of a block to each color, their sums
+// over the block, and the sums over each glyph's set pixels.
+typedef struct {
+    u32 dist[BLOCK_PIXELS][16];
+    u32 total[16];
+    u32 sums[256][16];
+} costs_t;
+
+// The palette laid out for the kernels.
+static s32 palette_r[16];
+static s32 palette_g[16];
+static s32 palette_b[16];
+static s16 palette_rg[32]; // r, g per color
+static s16 palette_b0[32]; // b, 0 per color
+
+typedef void (* distances_t)(costs_t * costs, const u8 * pixels, int pitch);
+
+// Fill in `costs->sums` and return the glyph with the least error, with the
+// error in `error`.
+typedef int (* search_t)(costs_t * costs, u32 * error);
+
+static distances_t Distances;
+static search_t Search;
+
+static void DistancesScalar(costs_t * costs, const u8 * pixels, int pitch)
+{
+    memset(costs->total, 0, sizeof(costs->total));
+
+    for ( int y = 0; y < FONT_H; y++ ) {
+        const u8 * p = pixels + y * pitch;
+        for ( int x = 0; x < FONT_W; x++, p += 3 ) {
+            u32 * dist = costs->dist[y * FONT_W + x];
+            for ( int c = 0; c < 16; c++ ) {
+                int dr = p[0] - palette_r[c];
+                int dg = p[1] - palette_g[c];
+                int db = p[2] - palette_b[c];
+                dist[c] = dr * dr + dg * dg + db * db;
+                costs->total[c] += dist[c];
+            }
+        }
+    }
+}
+
+static int SearchScalar(costs_t * costs, u32 * error)
+{
+    int best = 0;
+    *error = UINT32_MAX;
+
+    for ( int g = 0; g < num_glyphs; g++ ) {
+        const glyph_t * glyph = &glyphs[g];
+        u32 sum[16];
+
+        for ( int c = 0; c < 16; c++ ) {
+            if ( glyph->parent == -1 ) {
+                sum[c] = 0;
+            } else if ( glyph->flip ) {
+                sum[c] = costs->total[c] - costs->sums[glyph->parent][c];
+            } else {
+                sum[c] = costs->sums[glyph->parent][c];
+            }
+        }
+
+        const u8 * p = glyph->pixels;
+        for ( int i = 0; i < glyph->num_add; i++, p++ ) {
+            for ( int c = 0; c < 16; c++ ) {
+                sum[c] += costs->dist[*p][c];
+            }
+        }
+        for ( int i = 0; i < glyph->num_sub; i++, p++ ) {
+            for ( int c = 0; c < 16; c++ ) {
+                sum[c] -= costs->dist[*p][c];
+            }
+        }
+
+        u32 min_on = UINT32_MAX;
+        u32 min_off = UINT32_MAX;
+        for ( int c = 0; c < 16; c++ ) {
+            costs->sums[g][c] = sum[c];
+            min_on = MIN(min_on, sum[c]);
+            min_off = MIN(min_off, costs->total[c] - sum[c]);
+        }
+
+        if ( min_on + min_off < *error ) {
+            *error = min_on + min_off;
+            best = g;
+        }
+    }
+
+    return best;
+}
+
+#ifdef CONVERT_X86
+#ifdef __SSE2__
+// Errors stay far below 2^31, so signed compares will do.
+static inline __m128i Min32(__m128i a, __m128i b)
+{
+    __m128i greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+}
+
+static inline u32 HorizontalMin32(__m128i m)
+{
+    m = Min32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = Min32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (u32)_mm_cvtsi128_si32(m);
+}
+
+// SSE2 has no 32-bit multiply, so the differences are 16-bit pairs, r and g
+// then b and 0, squared and added pairwise by madd.
+static void DistancesSSE2(costs_t * costs, const u8 * pixels, int pitch)
+{
+    __m128i total[4];
+    __m128i rg[4];
+    __m128i b0[4];
+    for ( int i = 0; i < 4; i++ ) {
+        total[i] = _mm_setzero_si128();
+        rg[i] = _mm_loadu_si128((const __m128i *)&palette_rg[i * 8]);
+        b0[i] = _mm_loadu_si128((const __m128i *)&palette_b0[i * 8]);
+    }
+
+    for ( int y = 0; y < FONT_H; y++ ) {
+        const u8 * p = pixels + y * pitch;
+        for ( int x = 0; x < FONT_W; x++, p += 3 ) {
+            __m128i pixel_rg = _mm_set1_epi32(p[0] | p[1] << 16);
+            __m128i pixel_b0 = _mm_set1_epi32(p[2]);
+            u32 * dist = costs->dist[y * FONT_W + x];
+
+            for ( int i = 0; i < 4; i++ ) {
+                __m128i d_rg = _mm_sub_epi16(pixel_rg, rg[i]);
+                __m128i d_b0 = _mm_sub_epi16(pixel_b0, b0[i]);
+                __m128i d = _mm_add_epi32(_mm_madd_epi16(d_rg, d_rg),
+                                          _mm_madd_epi16(d_b0, d_b0));
+                _mm_storeu_si128((__m128i *)(dist + i * 4), d);
+                total[i] = _mm_add_epi32(total[i], d);
+            }
+        }
+    }
+
+    for ( int i = 0; i < 4; i++ ) {
+        _mm_storeu_si128((__m128i *)(costs->total + i * 4), total[i]);
+    }
+}
+
+static int SearchSSE2(costs_t * costs, u32 * error)
+{
+    __m128i total[4];
+    for ( int i = 0; i < 4; i++ ) {
+        total[i] = _mm_loadu_si128((const __m128i *)costs->total + i);
+    }
+
+    int best = 0;
+    *error = UINT32_MAX;
+
+    for ( int g = 0; g < num_glyphs; g++ ) {
+        const glyph_t * glyph = &glyphs[g];
+
+        __m128i sum[4];
+        for ( int i = 0; i < 4; i++ ) {
+            if ( glyph->parent == -1 ) {
+                sum[i] = _mm_setzero_si128();
+            } else {
+                sum[i] = _mm_loadu_si128((const __m128i *)costs->sums[glyph->parent] + i);
+                if ( glyph->flip ) {
+                    sum[i] = _mm_sub_epi32(total[i], sum[i]);
+                }
+            }
+        }
+
+        const u8 * p = glyph->pixels;
+        for ( int j = 0; j < glyph->num_add; j++, p++ ) {
+            const __m128i * dist = (const __m128i *)costs->dist[*p];
+            for ( int i = 0; i < 4; i++ ) {
+                sum[i] = _mm_add_epi32(sum[i], _mm_loadu_si128(dist + i));
+            }
+        }
+        for ( int j = 0; j < glyph->num_sub; j++, p++ ) {
+            const __m128i * dist = (const __m128i *)costs->dist[*p];
+            for ( int i = 0; i < 4; i++ ) {
+                sum[i] = _mm_sub_epi32(sum[i], _mm_loadu_si128(dist + i));
+            }
+        }
+
+        __m128i min_on = sum[0];
+        __m128i min_off = _mm_sub_epi32(total[0], sum[0]);
+        for ( int i = 0; i < 4; i++ ) {
+            _mm_storeu_si128((__m128i *)costs->sums[g] + i, sum[i]);
+            min_on = Min32(min_on, sum[i]);
+            min_off = Min32(min_off, _mm_sub_epi32(total[i], sum[i]));
+        }
+
+        u32 e = HorizontalMin32(min_on) + HorizontalMin32(min_off);
+        if ( e < *error ) {
+            *error = e;
+            best = g;
+        }
+    }
+
+    return best;
+}
+#endif
+
+__attribute__((target("avx2")))
+static void DistancesAVX2(costs_t * costs, const u8 * pixels, int pitch)
+{
+    __m256i r[2], g[2], b[2], total[2];
+    for ( int i = 0; i < 2; i++ ) {
+        r[i] = _mm256_loadu_si256((const __m256i *)&palette_r[i * 8]);
+        g[i] = _mm256_loadu_si256((const __m256i *)&palette_g[i * 8]);
+        b[i] = _mm256_loadu_si256((const __m256i *)&palette_b[i * 8]);
+        total[i] = _mm256_setzero_si256();
+    }
+
+    for ( int y = 0; y < FONT_H; y++ ) {
+        const u8 * p = pixels + y * pitch;
+        for ( int x = 0; x < FONT_W; x++, p += 3 ) {
+            __m256i pixel_r = _mm256_set1_epi32(p[0]);
+            __m256i pixel_g = _mm256_set1_epi32(p[1]);
+            __m256i pixel_b = _mm256_set1_epi32(p[2]);
+            u32 * dist = costs->dist[y * FONT_W + x];
+
+            for ( int i = 0; i < 2; i++ ) {
+                __m256i dr = _mm256_sub_epi32(pixel_r, r[i]);
+                __m256i dg = _mm256_sub_epi32(pixel_g, g[i]);
+                __m256i db = _mm256_sub_epi32(pixel_b, b[i]);
+                __m256i d = _mm256_add_epi32(_mm256_mullo_epi32(dr, dr),
+                                             _mm256_mullo_epi32(dg, dg));
+                d = _mm256_add_epi32(d, _mm256_mullo_epi32(db, db));
+                _mm256_storeu_si256((__m256i *)(dist + i * 8), d);
+                total[i] = _mm256_add_epi32(total[i], d);
+            }
+        }
+    }
+
+    for ( int i = 0; i < 2; i++ ) {
+        _mm256_storeu_si256((__m256i *)(costs->total + i * 8), total[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline u32 HorizontalMinU32(__m256i v)
+{
+    __m128i m = _mm_min_epu32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (u32)_mm_cvtsi128_si32(m);
+}
+
+__attribute__((target("avx2")))
+static int SearchAVX2(costs_t * costs, u32 * error)
+{
+    __m256i total0 = _mm256_loadu_si256((const __m256i *)costs->total);
+    __m256i total1 = _mm256_loadu_si256((const __m256i *)costs->total + 1);
+
+    int best = 0;
+    *error = UINT32_MAX;
+
+    for ( int g = 0; g < num_glyphs; g++ ) {
+        const glyph_t * glyph = &glyphs[g];
+
+        __m256i sum0 = _mm256_setzero_si256();
+        __m256i sum1 = _mm256_setzero_si256();
+        if ( glyph->parent != -1 ) {
+            const __m256i * parent = (const __m256i *)costs->sums[glyph->parent];
+            sum0 = _mm256_loadu_si256(parent);
+            sum1 = _mm256_loadu_si256(parent + 1);
+            if ( glyph->flip ) {
+                sum0 = _mm256_sub_epi32(total0, sum0);
+                sum1 = _mm256_sub_epi32(total1, sum1);
+            }
+        }
+
+        const u8 * p = glyph->pixels;
+        for ( int i = 0; i < glyph->num_add; i++, p++ ) {
+            const __m256i * dist = (const __m256i *)costs->dist[*p];
+            sum0 = _mm256_add_epi32(sum0, _mm256_loadu_si256(dist));
+            sum1 = _mm256_add_epi32(sum1, _mm256_loadu_si256(dist + 1));
+        }
+        for ( int i = 0; i < glyph->num_sub; i++, p++ ) {
+            const __m256i * dist = (const __m256i *)costs->dist[*p];
+            sum0 = _mm256_sub_epi32(sum0, _mm256_loadu_si256(dist));
+            sum1 = _mm256_sub_epi32(sum1, _mm256_loadu_si256(dist + 1));
+        }
+
+        __m256i * out = (__m256i *)costs->sums[g];
+        _mm256_storeu_si256(out, sum0);
+        _mm256_storeu_si256(out + 1, sum1);
+
+        __m256i off0 = _mm256_sub_epi32(total0, sum0);
+        __m256i off1 = _mm256_sub_epi32(total1, sum1);
+        u32 e = HorizontalMinU32(_mm256_min_epu32(sum0, sum1))
+              + HorizontalMinU32(_mm256_min_epu32(off0, off1));
+        if ( e < *error ) {
+            *error = e;
+            best = g;
+        }
+    }
+
+    return best;
+}
+#endif
+
+static void InitConvert(void)
+{
+    if ( Distances ) {
+        return;
+    }
+
+    for ( int c = 0; c < 16; c++ ) {
+        palette_r[c] = palette[c].r;
+        palette_g[c] = palette[c].g;
+        palette_b[c] = palette[c].b;
+        palette_rg[c * 2] = palette[c].r;
+        palette_rg[c * 2 + 1] = palette[c].g;
+        palette_b0[c * 2] = palette[c].b;
+        palette_b0[c * 2 + 1] = 0;
+    }
+
+    // The distinct shapes.
+    u64 masks[256][2];
+    u8 chars[256];
+    int count = 0;
+    for ( int ch = 0; ch < 256; ch++ ) {
+        u64 mask[2] = { 0, 0 };
+        for ( int y = 0; y < FONT_H; y++ ) {
+            u8 bits = cp437[ch * FONT_H + y];
+            for ( int x = 0; x < FONT_W; x++ ) {
+                if ( bits & (0x80 >> x) ) {
+                    int p = y * FONT_W + x;
+                    mask[p >> 6] |= 1ull << (p & 63);
+                }
+            }
+        }
+
+        bool seen = false;
+        for ( int i = 0; i < count && !seen; i++ ) {
+            seen = (mask[0] == masks[i][0] && mask[1] == masks[i][1])
+                || (mask[0] == ~masks[i][0] && mask[1] == ~masks[i][1]);
+        }
+
+        if ( !seen ) {
+            masks[count][0] = mask[0];
+            masks[count][1] = mask[1];
+            chars[count] = ch;
+            count++;
+        }
+    }
+
+    // Then as a minimum spanning tree (Prim's), grown from the first glyph,
+    // where each step costs the pixels that differ from the parent or from
+    // its inverse, whichever is fewer.
+    bool added[256] = { false };
+    int distance[256];
+    int parent[256];
+    bool flip[256];
+    int index[256]; // Of each shape in `glyphs`
+    for ( int i = 0; i < count; i++ ) {
+        distance[i] = INT32_MAX;
+        parent[i] = -1;
+        flip[i] = false;
+    }
+    distance[0] = 0;
+
+    for ( num_glyphs = 0; num_glyphs < count; num_glyphs++ ) {
+        int next = -1;
+        for ( int i = 0; i < count; i++ ) {
+            if ( !added[i] && (next == -1 || distance[i] < distance[next]) ) {
+                next = i;
+            }
+        }
+
+        added[next] = true;
+        index[next] = num_glyphs;
+
+        glyph_t * glyph = &glyphs[num_glyphs];
+        glyph->ch = chars[next];
+        glyph->mask[0] = masks[next][0];
+        glyph->mask[1] = masks[next][1];
+        glyph->parent = parent[next] == -1 ? -1 : index[parent[next]];
+        glyph->flip = flip[next];
+
+        u64 from[2] = { 0, 0 };
+        if ( parent[next] != -1 ) {
+            from[0] = flip[next] ? ~masks[parent[next]][0] : masks[parent[next]][0];
+            from[1] = flip[next] ? ~masks[parent[next]][1] : masks[parent[next]][1];
+        }
+
+        glyph->num_add = 0;
+        glyph->num_sub = 0;
+        for ( int p = 0; p < BLOCK_PIXELS; p++ ) {
+            if ( (glyph->mask[p >> 6] & ~from[p >> 6]) >> (p & 63) & 1 ) {
+                glyph->pixels[glyph->num_add++] = p;
+            }
+        }
+        for ( int p = 0; p < BLOCK_PIXELS; p++ ) {
+            if ( (from[p >> 6] & ~glyph->mask[p >> 6]) >> (p & 63) & 1 ) {
+                glyph->pixels[glyph->num_add + glyph->num_sub++] = p;
+            }
+        }
+
+        for ( int i = 0; i < count; i++ ) {
+            if ( added[i] ) {
+                continue;
+            }
+
+            int differ = __builtin_popcountll(masks[i][0] ^ masks[next][0])
+                       + __builtin_popcountll(masks[i][1] ^ masks[next][1]);
+            if ( differ < distance[i] ) {
+                distance[i] = differ;
+                parent[i] = next;
+                flip[i] = false;
+            }
+            if ( BLOCK_PIXELS - differ < distance[i] ) {
+                distance[i] = BLOCK_PIXELS - differ;
+                parent[i] = next;
+                flip[i] = true;
+            }
+        }
+    }
+
+    Distances = DistancesScalar;
+    Search = SearchScalar;
+#ifdef CONVERT_X86
+#ifdef __SSE2__
+    Distances = DistancesSSE2;
+    Search = SearchSSE2;
+#endif
+    if ( SDL_HasAVX2() ) {
+        Distances = DistancesAVX2;
+        Search = SearchAVX2;
+    }
+#endif
+}
+
+// Cells whose glyph shows nothing, or that are one color, are kept blank
+// (glyph and foreground zero) so they compress and read as empty.
+static u16 MakeCell(int ch, int fg, int bg)
+{
+    if ( ch == 0 || fg == bg ) {
+        return bg << 12;
+    }
+
+    return bg << 12 | fg << 8 | ch;
+}
+
+static int NearestColor(const u8 * rgb)
+{
+    int best = 0;
+    int best_dist = INT32_MAX;
+    for ( int c = 0; c < 16; c++ ) {
+        int dr = rgb[0] - palette[c].r;
+        int dg = rgb[1] - palette[c].g;
+        int db = rgb[2] - palette[c].b;
+        int dist = dr * dr + dg * dg + db * db;
+        if ( dist < best_dist ) {
+            best = c;
+            best_dist = dist;
+        }
+    }
+
+    return best;
+}
+
+static int PaletteIndex(const u8 * rgb)
+{
+    for ( int c = 0; c < 16; c++ ) {
+        if ( rgb[0] == palette[c].r && rgb[1] == palette[c].g && rgb[2] == palette[c].b ) {
+            return c;
+        }
+    }
+
+    return -1;
+}
+
+static int ArgMin(const u32 * values)
+{
+    int best = 0;
+    for ( int i = 1; i < 16; i++ ) {
+        if ( values[i] < values[best] ) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+// Blocks of one color, and blocks already drawn in two palette colors with a
+// glyph's exact shape (screenshots of text screens, say), are found from the
+// block's bitmask without a search. Returns -1 for any other block.
+static int MatchSimple(const u8 * pixels, int pitch)
+{
+    const u8 * first = pixels;
+    const u8 * other = NULL;
+    u64 mask[2] = { 0, 0 }; // Pixels that aren't `first`
+
+    for ( int y = 0; y < FONT_H; y++ ) {
+        const u8 * p = pixels + y * pitch;
+        for ( int x = 0; x < FONT_W; x++, p += 3 ) {
+            if ( p[0] == first[0] && p[1] == first[1] && p[2] == first[2] ) {
+                continue;
+            }
+
+            if ( other == NULL ) {
+                other = p;
+            } else if ( p[0] != other[0] || p[1] != other[1] || p[2] != other[2] ) {
+                return -1;
+            }
+
+            int i = y * FONT_W + x;
+            mask[i >> 6] |= 1ull << (i & 63);
+        }
+    }
+
+    if ( other == NULL ) {
+        return MakeCell(0, 0, NearestColor(first));
+    }
+
+    int a = PaletteIndex(first);
+    int b = PaletteIndex(other);
+    if ( a == -1 || b == -1 ) {
+        return -1;
+    }
+
+    for ( int i = 0; i < num_glyphs; i++ ) {
+        const u64 * glyph = glyphs[i].mask;
+        if ( mask[0] == glyph[0] && mask[1] == glyph[1] ) {
+            return MakeCell(glyphs[i].ch, b, a);
+        } else if ( mask[0] == ~glyph[0] && mask[1] == ~glyph[1] ) {
+            return MakeCell(glyphs[i].ch, a, b);
+        }
+    }
+
+    return -1;
+}
+
+static u16 MatchBlock(costs_t * costs, const u8 * pixels, int pitch)
+{
+    int simple = MatchSimple(pixels, pitch);
+    if ( simple != -1 ) {
+        return simple;
+    }
+
+    Distances(costs, pixels, pitch);
+
+    u32 error;
+    int g = Search(costs, &error);
+
+    u32 off[16];
+    for ( int c = 0; c < 16; c++ ) {
+        off[c] = costs->total[c] - costs->sums[g][c];
+    }
+
+    return MakeCell(glyphs[g].ch, ArgMin(costs->sums[g]), ArgMin(off));
+}
+
+typedef struct {
+    u16 * cells;
+    int w;
+    int h;
+    const u8 * pixels;
+    int pitch;
+    SDL_atomic_t next_row;
+} job_t;
+
+// Match rows of cells until there are none left.
+static int MatchRows(void * data)
+{
+    job_t * job = data;
+    costs_t costs;
+
+    int y;
+    while ( (y = SDL_AtomicAdd(&job->next_row, 1)) < job->h ) {
+        const u8 * row = job->pixels + (size_t)y * FONT_H * job->pitch;
+        u16 * cells = job->cells + (size_t)y * job->w;
+        for ( int x = 0; x < job->w; x++ ) {
+            cells[x] = MatchBlock(&costs, row + x * FONT_W * 3, job->pitch);
+        }
+    }
+
+    return 0;
+}
+
+void MatchCells(u16 * cells, int w, int h, const u8 * pixels, int pitch, int threads)
+{
+    InitConvert();
+
+    job_t job = {
+        .cells = cells,
+        .w = w,
+        .h = h,
+        .pixels = pixels,
+        .pitch = pitch,
+    };
+    SDL_AtomicSet(&job.next_row, 0);
+
+    threads = MAX(1, MIN(threads, MIN(h, MAX_THREADS)));
+    SDL_Thread * thread[MAX_THREADS];
+    for ( int i = 1; i < threads; i++ ) {
+        thread[i] = SDL_CreateThread(MatchRows, "convert", &job);
+    }
+
+    MatchRows(&job);
+
+    for ( int i = 1; i < threads; i++ ) {
+        if ( thread[i] ) {
+            SDL_WaitThread(thread[i], NULL);
+        }
+    }
+}
+
+// The next number in a PPM header, skipping white space and comments, or -1.
+static int ReadNumber(FILE * file)
+{
+    int c = fgetc(file);
+    while ( isspace(c) || c == '#' ) {
+        if ( c == '#' ) {
+            while ( c != '\n' && c != EOF ) {
+                c = fgetc(file);
+            }
+        }
+        c = fgetc(file);
+    }
+
+    if ( !isdigit(c) ) {
+        return -1;
+    }
+
+    // The single white space character after the number is consumed too.
+    int n = 0;
+    for ( ; isdigit(c); c = fgetc(file) ) {
+        n = n * 10 + c - '0';
+        if ( n > MAX_IMAGE_SIZE ) {
+            return -1;
+        }
+    }
+
+    return n;
+}
+
+static u8 * LoadPPM(const char * path, FILE * file, int * w, int * h)
+{
+    *w = ReadNumber(file);
+    *h = ReadNumber(file);
+    int max = ReadNumber(file);
+    if ( *w < 1 || *h < 1 || max < 1 || max > 255 ) {
+        printf("'%s' isn't a supported PPM (8-bit P6) or is too big\n", path);
+        return NULL;
+    }
+
+    size_t size = (size_t)*w * *h * 3;
+    u8 * pixels = malloc(size);
+    if ( pixels == NULL ) {
+        printf("Failed to load '%s': out of memory\n", path);
+        return NULL;
+    }
+
+    if ( fread(pixels, 1, size, file) != size ) {
+        printf("Failed to read '%s'\n", path);
+        free(pixels);
+        return NULL;
+    }
+
+    if ( max != 255 ) {
+        for ( size_t i = 0; i < size; i++ ) {
+            pixels[i] = MIN(pixels[i], max) * 255 / max;
+        }
+    }
+
+    return pixels;
+}
+
+static u8 * LoadBMP(const char * path, int * w, int * h)
+{
+    SDL_Surface * loaded = SDL_LoadBMP(path);
+    if ( loaded == NULL ) {
+        printf("Failed to load '%s': %s\n", path, SDL_GetError());
+        return NULL;
+    }
+
+    SDL_Surface * surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGB24, 0);
+    SDL_FreeSurface(loaded);
+    if ( surface == NULL ) {
+        printf("Failed to convert '%s': %s\n", path, SDL_GetError());
+        return NULL;
+    }
+
+    *w = surface->w;
+    *h = surface->h;
+    u8 * pixels = NULL;
+    if ( *w <= MAX_IMAGE_SIZE && *h <= MAX_IMAGE_SIZE ) {
+        pixels = malloc((size_t)*w * *h * 3);
+    }
+
+    if ( pixels == NULL ) {
+        printf("Failed to load '%s': too big\n", path);
+    } else {
+        for ( int y = 0; y < *h; y++ ) {
+            memcpy(pixels + (size_t)y * *w * 3,
+                   (const u8 *)surface->pixels + (size_t)y * surface->pitch,
+                   (size_t)*w * 3);
+        }
+    }
+
+    SDL_FreeSurface(surface);
+    return pixels;
+}
+
+// Load `path` as tightly packed RGB24.
+static u8 * LoadImage(const char * path, int * w, int * h)
+{
+    FILE * file = fopen(path, "rb");
+    if ( file == NULL ) {
+        printf("Failed to open '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    char magic[2] = { 0 };
+    size_t n = fread(magic, 1, 2, file);
+
+    u8 * pixels = NULL;
+    if ( n == 2 && magic[0] == 'P' && magic[1] == '6' ) {
+        pixels = LoadPPM(path, file, w, h);
+        fclose(file);
+    } else if ( n == 2 && magic[0] == 'B' && magic[1] == 'M' ) {
+        fclose(file);
+        pixels = LoadBMP(path, w, h);
+    } else {
+        fclose(file);
+        printf("'%s' isn't a BMP or binary PPM file\n", path);
+    }
+
+    return pixels;
+}
+
+// Scale `in` to new_w x new_h, each pixel the average of those it covers.
+static u8 * Resample(const u8 * in, int w, int h, int new_w, int new_h)
+{
+    u8 * out = malloc((size_t)new_w * new_h * 3);
+    if ( out == NULL ) {
+        return NULL;
+    }
+
+    u8 * p = out;
+    for ( int y = 0; y < new_h; y++ ) {
+        int top = (int)((s64)y * h / new_h);
+        int bottom = MAX((int)((s64)(y + 1) * h / new_h), top + 1);
+
+        for ( int x = 0; x < new_w; x++ ) {
+            int left = (int)((s64)x * w / new_w);
+            int right = MAX((int)((s64)(x + 1) * w / new_w), left + 1);
+
+            u32 sum[3] = { 0, 0, 0 };
+            for ( int sy = top; sy < bottom; sy++ ) {
+                const u8 * row = in + ((size_t)sy * w + left) * 3;
+                for ( int sx = left; sx < right; sx++, row += 3 ) {
+                    sum[0] += row[0];
+                    sum[1] += row[1];
+                    sum[2] += row[2];
+                }
+            }
+
+            u32 count = (u32)(right - left) * (bottom - top);
+            for ( int i = 0; i < 3; i++ ) {
+                *p++ = (sum[i] + count / 2) / count;
+            }
+        }
+    }
+
+    return out;
+}
+
+bool ConvertImage(const char * path, int width)
+{
+    int image_w, image_h;
+    u8 * pixels = LoadImage(path, &image_w, &image_h);
+    if ( pixels == NULL ) {
+        return false;
+    }
+
+    // Keep the aspect at `width` cells across, or round to the nearest whole
+    // number of cells.
+    int w, h;
+    if ( width > 0 ) {
+        w = width;
+        h = (int)((double)image_h * width * FONT_W / ((double)image_w * FONT_H) + 0.5);
+    } else {
+        w = (image_w + FONT_W / 2) / FONT_W;
+        h = (image_h + FONT_H / 2) / FONT_H;
+    }
+    CLAMP(w, 1, MAX_WIDTH);
+    CLAMP(h, 1, MAX_HEIGHT);
+
+    int pixel_w = w * FONT_W;
+    int pixel_h = h * FONT_H;
+    if ( pixel_w != image_w || pixel_h != image_h ) {
+        u8 * scaled = Resample(pixels, image_w, image_h, pixel_w, pixel_h);
+        free(pixels);
+        pixels = scaled;
+    }
+
+    u16 * cells = pixels ? malloc((size_t)w * h * sizeof(*cells)) : NULL;
+    if ( cells == NULL ) {
+        printf("Failed to convert '%s': out of memory\n", path);
+        free(pixels);
+        return false;
+    }
+
+    MatchCells(cells, w, h, pixels, pixel_w * 3, SDL_GetCPUCount());
+
+    ClearMap();
+    for ( int y = 0; y < h; y++ ) {
+        WriteCells(0, y, w, &cells[y * w]);
+    }
+    app_w = w;
+    app_h = h;
+
+    free(cells);
+    free(pixels);
+    return true;
+}
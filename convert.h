@@ -0,0 +1,27 @@
+//
+//  convert.h
+//  TextAppMaker
+//
+//  Turns pictures into screens: every FONT_W x FONT_H block of pixels becomes
+//  the glyph, foreground and background color that reproduce it with the
+//  least squared RGB error.
+//
+
+#ifndef convert_h
+#define convert_h
+
+#include "common.h"
+#include <stdbool.h>
+
+/// Match each block of the w * FONT_W x h * FONT_H RGB24 `pixels`, `pitch`
+/// bytes apart, to a cell in `cells` (w x h), using up to `threads` threads.
+void MatchCells(u16 * cells, int w, int h, const u8 * pixels, int pitch, int threads);
+
+/// Replace the work area with the image at `path`, a BMP or binary PPM file.
+/// If `width` isn't zero the image is first scaled to that many cells across,
+/// keeping its aspect; otherwise each block of pixels is one cell, the image
+/// stretched a little to a whole number of them if need be. Uses every CPU.
+/// Prints why and returns false on failure.
+bool ConvertImage(const char * path, int width);
+
+#endif /* convert_h */
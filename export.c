@@ -0,0 +1,259 @@
+//
+//  export.c
+//  TextAppMaker
+//
+
+#include "export.h"
+#include "ansi.h"
+#include "charset.h"
+#include "map.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// Everything is written through one buffer, so even a large screen only
+// takes a handful of writes.
+static char buffer[256 * 1024];
+static size_t buffer_used;
+static FILE * out;
+static bool write_error;
+
+// Set to write the output as the body of a C string literal, one source
+// line per output line.
+static bool as_literal;
+static int literal_column;
+
+static void WriteLiteral(const char * s, size_t length)
+{
+    for ( size_t i = 0; i < length; i++ ) {
+        u8 c = (u8)s[i];
+
+        if ( literal_column == 0 ) {
+            fputs("    \"", out);
+            literal_column = 5;
+        }
+
+        // Octal escapes, unlike hex, can't run into the next character.
+        if ( c >= ' ' && c <= '~' && c != '"' && c != '\\' && c != '?' ) {
+            fputc(c, out);
+            literal_column++;
+        } else {
+            fprintf(out, "\\%03o", c);
+            literal_column += 4;
+        }
+
+        if ( c == '\n' || literal_column >= 72 ) {
+            fputs("\"\n", out);
+            literal_column = 0;
+        }
+    }
+}
+
+static void Flush(void)
+{
+    if ( as_literal ) {
+        WriteLiteral(buffer, buffer_used);
+    } else if ( buffer_used && fwrite(buffer, 1, buffer_used, out) != buffer_used ) {
+        write_error = true;
+    }
+    buffer_used = 0;
+}
+
+static inline void Put(const char * s, size_t length)
+{
+    if ( buffer_used + length > sizeof(buffer) ) {
+        Flush();
+    }
+    memcpy(buffer + buffer_used, s, length);
+    buffer_used += length;
+}
+
+// Glyphs that would upset a terminal if sent as raw bytes.
+static bool IsControlByte(int ch)
+{
+    return ch == 0 || ch == '\a' || ch == '\b' || ch == '\t' || ch == '\n'
+        || ch == '\r' || ch == 0x1A || ch == 0x1B;
+}
+
+// Write a row's cells up to and including `end`, tracking the terminal's
+// colors in `fg` and `bg`.
+static void ExportRow(const u16 * cells, int end, int format, int * fg, int * bg)
+{
+    for ( int x = 0; x <= end; x++ ) {
+        u16 cell = cells[x];
+        int ch = GET_CHAR(cell);
+
+        if ( format != EXPORT_TEXT ) {
+            char sgr[ANSI_MAX_SEQUENCE];
+            Put(sgr, FormatColors(sgr, cell, fg, bg));
+        }
+
+        if ( format == EXPORT_ANSI_CP437 ) {
+            char byte = IsControlByte(ch) ? ' ' : (char)ch;
+            Put(&byte, 1);
+        } else {
+            int length;
+            const char * utf8 = CP437ToUTF8((u8)ch, &length);
+            Put(utf8, length);
+        }
+    }
+}
+
+// Write every row to `out`, ending each but the last with a line break, and
+// that too if `final_newline`.
+static void ExportRows(int format, bool final_newline)
+{
+    buffer_used = 0;
+
+    static const char reset[] = "\x1b[0m";
+    const char * newline = format == EXPORT_TEXT ? "\n" : "\r\n";
+    int fg = 7;
+    int bg = 0;
+
+    if ( format != EXPORT_TEXT ) {
+        Put(reset, sizeof(reset) - 1);
+    }
+
+    static u16 row[MAX_WIDTH];
+    for ( int y = 0; y < app_h; y++ ) {
+        ReadCells(0, y, app_w, row);
+
+        // Trailing cells that look the same as an empty line.
+        int end = app_w - 1;
+        while ( end >= 0
+               && IsBlankGlyph(GET_CHAR(row[end]))
+               && (format == EXPORT_TEXT || GET_BG(row[end]) == 0) )
+        {
+            end--;
+        }
+
+        ExportRow(row, end, format, &fg, &bg);
+
+        // Don't let the background bleed into the next line if it scrolls.
+        if ( bg != 0 ) {
+            Put("\x1b[40m", 5);
+            bg = 0;
+        }
+
+        if ( y < app_h - 1 || final_newline ) {
+            Put(newline, strlen(newline));
+        }
+    }
+
+    if ( format != EXPORT_TEXT ) {
+        Put(reset, sizeof(reset) - 1);
+    }
+
+    Flush();
+}
+
+bool ExportFile(const char * path, int format)
+{
+    out = fopen(path, "wb");
+    if ( out == NULL ) {
+        printf("Failed to create '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+
+    write_error = false;
+    ExportRows(format, true);
+
+    if ( fclose(out) != 0 ) {
+        write_error = true;
+    }
+    out = NULL;
+
+    if ( write_error ) {
+        printf("Failed to write '%s'\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool ExportHeader(const char * path, const char * name, bool ansi)
+{
+    out = fopen(path, "w");
+    if ( out == NULL ) {
+        printf("Failed to create '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+
+    write_error = false;
+
+    char upper[256];
+    size_t length = MIN(strlen(name), sizeof(upper) - 1);
+    for ( size_t i = 0; i < length; i++ ) {
+        upper[i] = (char)toupper((u8)name[i]);
+    }
+    upper[length] = '\0';
+
+    fprintf(out, "//\n//  Generated by TextAppMaker. Do not edit.\n//\n\n");
+    fprintf(out, "#ifndef %s_screen_h\n#define %s_screen_h\n\n", name, name);
+    fprintf(out,
+            "#ifndef SCREEN_CONST\n"
+            "#ifdef __cplusplus\n"
+            "#define SCREEN_CONST constexpr\n"
+            "#else\n"
+            "#define SCREEN_CONST const\n"
+            "#endif\n"
+            "#endif\n\n");
+    fprintf(out, "#define %s_W %d\n#define %s_H %d\n\n", upper, app_w, upper, app_h);
+
+    // The cells, eight to a line like cp437.h.
+    fprintf(out, "static SCREEN_CONST unsigned short %s[%d * %d] =\n{\n", name, app_w, app_h);
+
+    static u16 row[MAX_WIDTH];
+    int column = 0;
+    for ( int y = 0; y < app_h; y++ ) {
+        ReadCells(0, y, app_w, row);
+        for ( int x = 0; x < app_w; x++ ) {
+            fprintf(out, column == 0 ? "    0x%04x," : " 0x%04x,", row[x]);
+            if ( ++column == 8 ) {
+                fputc('\n', out);
+                column = 0;
+            }
+        }
+    }
+
+    if ( column ) {
+        fputc('\n', out);
+    }
+    fprintf(out, "};\n");
+
+    // The screen as a terminal would be sent it: clear, then draw, leaving
+    // the cursor on the last row so nothing scrolls.
+    if ( ansi ) {
+        fprintf(out, "\nstatic SCREEN_CONST char %s_ansi[] =\n", name);
+        as_literal = true;
+        literal_column = 0;
+        WriteLiteral("\x1b[H\x1b[2J", 7);
+        ExportRows(EXPORT_ANSI, false);
+        as_literal = false;
+
+        if ( literal_column ) {
+            fputs("\"\n", out);
+        }
+        fprintf(out, "    ;\n\n");
+        fprintf(out, "#define %s_ANSI_LENGTH (sizeof(%s_ansi) - 1)\n", upper, name);
+    }
+
+    fprintf(out, "\n#endif\n");
+
+    if ( ferror(out) ) {
+        write_error = true;
+    }
+    if ( fclose(out) != 0 ) {
+        write_error = true;
+    }
+    out = NULL;
+
+    if ( write_error ) {
+        printf("Failed to write '%s'\n", path);
+        return false;
+    }
+
+    return true;
+}
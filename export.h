@@ -0,0 +1,35 @@
+//
+//  export.h
+//  TextAppMaker
+//
+//  Writes the work area as something a terminal can show. ANSI output sets
+//  colors with SGR escape sequences, and only when a cell's colors differ
+//  from what the terminal already has: a blank cell doesn't care about its
+//  foreground and a solid block about its background. Trailing blank cells
+//  on the default (black) background are dropped. Output starts with a reset
+//  and assumes the terminal's default colors are then palette 7 on 0.
+//
+
+#ifndef export_h
+#define export_h
+
+#include <stdbool.h>
+
+enum {
+    EXPORT_TEXT,        // UTF-8, no color
+    EXPORT_ANSI,        // UTF-8 with escape sequences
+    EXPORT_ANSI_CP437,  // CP437 bytes with escape sequences, for BBS terminals
+};
+
+/// Write the whole work area to `path`. Prints why and returns false on
+/// failure.
+bool ExportFile(const char * path, int format);
+
+/// Write the work area as a C/C++ header for compiling into a program: the
+/// cells as an array called `name`, its size as NAME_W and NAME_H, and if
+/// `ansi`, a string `name`_ansi that clears a terminal and draws the screen
+/// with a single write. Arrays are constexpr in C++. Prints why and returns
+/// false on failure.
+bool ExportHeader(const char * path, const char * name, bool ansi);
+
+#endif /* export_h */
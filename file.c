@@ -0,0 +1,391 @@
+//
+//  file.c
+//  TextAppMaker
+//
+
+#include "file.h"
+#include "map.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define LEGACY_HEADER_SIZE 2
+#define V2_HEADER_SIZE 10
+#define V2_MAX_RUN 128
+
+static const u8 magic[4] = { 'T', 'A', 'M', 'S' };
+
+// One row of cells on its way between the file and the map.
+static u16 row[MAX_WIDTH];
+
+int save_format = FORMAT_V2;
+size_t mmap_threshold = 64 * 1024;
+
+// Bytes come either from a mapped file or from `file` one chunk at a time.
+typedef struct {
+    FILE * file;
+    const u8 * data;
+    size_t position;
+    size_t length;
+} reader_t;
+
+static u8 read_chunk[64 * 1024];
+
+static int ReadByte(reader_t * r)
+{
+    if ( r->position == r->length ) {
+        if ( r->file == NULL ) {
+            return -1;
+        }
+
+        r->length = fread(read_chunk, 1, sizeof(read_chunk), r->file);
+        r->data = read_chunk;
+        r->position = 0;
+
+        if ( r->length == 0 ) {
+            return -1;
+        }
+    }
+
+    return r->data[r->position++];
+}
+
+static bool ReadCell(reader_t * r, u16 * cell)
+{
+    int lo = ReadByte(r);
+    int hi = ReadByte(r);
+    *cell = (u16)(lo | hi << 8);
+
+    return lo != -1 && hi != -1;
+}
+
+static bool DecodeV2(reader_t * r, int w, int h)
+{
+    for ( int y = 0; y < h; y++ ) {
+        for ( int x = 0; x < w; ) {
+            int control = ReadByte(r);
+            if ( control == -1 ) {
+                return false;
+            }
+
+            int count = (control & 0x7F) + 1;
+            if ( x + count > w ) {
+                return false;
+            }
+
+            if ( control & 0x80 ) {
+                u16 cell;
+                if ( !ReadCell(r, &cell) ) {
+                    return false;
+                }
+                for ( int i = 0; i < count; i++ ) {
+                    row[x++] = cell;
+                }
+            } else if ( r->length - r->position >= count * 2u ) {
+                // Whole run is buffered, skip the per-byte checks.
+                const u8 * in = r->data + r->position;
+                for ( int i = 0; i < count; i++, in += 2 ) {
+                    row[x++] = (u16)(in[0] | in[1] << 8);
+                }
+                r->position += count * 2;
+            } else {
+                for ( int i = 0; i < count; i++ ) {
+                    if ( !ReadCell(r, &row[x++]) ) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        WriteCells(0, y, w, row);
+    }
+
+    return true;
+}
+
+static u8 * PutCell(u8 * out, u16 cell)
+{
+    *out++ = cell & 0xFF;
+    *out++ = cell >> 8;
+    return out;
+}
+
+static u8 * EncodeRowV2(u8 * out, const u16 * row, int w)
+{
+    for ( int x = 0; x < w; ) {
+        int run = 1;
+        while ( x + run < w && run < V2_MAX_RUN && row[x + run] == row[x] ) {
+            run++;
+        }
+
+        if ( run > 1 ) {
+            *out++ = 0x80 | (run - 1);
+            out = PutCell(out, row[x]);
+            x += run;
+            continue;
+        }
+
+        // Literals up to where the next repeat starts.
+        u8 * control = out++;
+        int count = 0;
+        while ( x < w
+               && count < V2_MAX_RUN
+               && (x + 1 == w || row[x + 1] != row[x]) )
+        {
+            out = PutCell(out, row[x++]);
+            count++;
+        }
+        *control = count - 1;
+    }
+
+    return out;
+}
+
+// Encode `map` into `buffer` and return the size.
+static size_t Encode(u8 * buffer)
+{
+    u8 * out = buffer;
+
+    if ( save_format == FORMAT_LEGACY ) {
+        *out++ = app_w;
+        *out++ = app_h;
+        for ( int y = 0; y < app_h; y++ ) {
+            ReadCells(0, y, app_w, row);
+            memcpy(out, row, app_w * sizeof(u16));
+            out += app_w * sizeof(u16);
+        }
+    } else {
+        memcpy(out, magic, sizeof(magic));
+        out += sizeof(magic);
+        *out++ = 2; // Version
+        *out++ = 0; // Flags
+        out = PutCell(out, app_w);
+        out = PutCell(out, app_h);
+        for ( int y = 0; y < app_h; y++ ) {
+            ReadCells(0, y, app_w, row);
+            out = EncodeRowV2(out, row, app_w);
+        }
+    }
+
+    return out - buffer;
+}
+
+bool SaveFile(const char * path)
+{
+    static u8 * buffer;
+    static size_t buffer_size;
+
+    if ( save_format == FORMAT_LEGACY && (app_w > UINT8_MAX || app_h > UINT8_MAX) ) {
+        printf("Failed to save '%s': legacy files can't be larger than 255 x 255\n", path);
+        return false;
+    }
+
+    // Worst case: all literals, one control byte per V2_MAX_RUN cells.
+    size_t row_bound = app_w * sizeof(u16) + (app_w + V2_MAX_RUN - 1) / V2_MAX_RUN;
+    size_t bound = V2_HEADER_SIZE + row_bound * app_h;
+
+    if ( bound > buffer_size ) {
+        u8 * new_buffer = realloc(buffer, bound);
+        if ( new_buffer == NULL ) {
+            printf("Failed to save '%s': out of memory\n", path);
+            return false;
+        }
+        buffer = new_buffer;
+        buffer_size = bound;
+    }
+
+    size_t size = Encode(buffer);
+
+    char temp_path[1024];
+    int length = snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    if ( length < 0 || (size_t)length >= sizeof(temp_path) ) {
+        printf("Failed to save '%s': path too long\n", path);
+        return false;
+    }
+
+    FILE * file = fopen(temp_path, "wb");
+    if ( file == NULL ) {
+        printf("Failed to create '%s': %s\n", temp_path, strerror(errno));
+        return false;
+    }
+
+    size_t written = fwrite(buffer, 1, size, file);
+    int close_error = fclose(file);
+
+    if ( written != size || close_error ) {
+        printf("Failed to write '%s': wrote %zu of %zu bytes\n", temp_path, written, size);
+        remove(temp_path);
+        return false;
+    }
+
+    if ( rename(temp_path, path) ) {
+        printf("Failed to replace '%s': %s\n", path, strerror(errno));
+        remove(temp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool CheckDimensions(const char * path, int w, int h)
+{
+    if ( w == 0 || h == 0 ) {
+        printf("'%s' has an invalid size (%d x %d)\n", path, w, h);
+        return false;
+    }
+
+    if ( w > MAX_WIDTH || h > MAX_HEIGHT ) {
+        printf("'%s' is %d x %d, larger than the editor supports\n", path, w, h);
+        return false;
+    }
+
+    return true;
+}
+
+static bool LoadLegacy(const char * path, FILE * file, const u8 * header, size_t size)
+{
+    int w = header[0];
+    int h = header[1];
+    size_t expected = LEGACY_HEADER_SIZE + (size_t)w * h * sizeof(u16);
+
+    if ( !CheckDimensions(path, w, h) ) {
+        return false;
+    }
+
+    if ( size < expected ) {
+        printf("'%s' is truncated: expected %zu bytes, got %zu\n", path, expected, size);
+        return false;
+    }
+
+#ifndef _WIN32
+    if ( size >= mmap_threshold ) {
+        const u8 * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if ( data != MAP_FAILED ) {
+            ClearMap();
+            size_t row_size = w * sizeof(u16);
+            for ( int y = 0; y < h; y++ ) {
+                memcpy(row, data + LEGACY_HEADER_SIZE + y * row_size, row_size);
+                WriteCells(0, y, w, row);
+            }
+            munmap((void *)data, size);
+
+            app_w = w;
+            app_h = h;
+            return true;
+        }
+    }
+#endif
+
+    ClearMap();
+    fseek(file, LEGACY_HEADER_SIZE, SEEK_SET);
+    for ( int y = 0; y < h; y++ ) {
+        if ( fread(row, sizeof(u16), w, file) != (size_t)w ) {
+            printf("Failed to read '%s': short read at row %d\n", path, y);
+            return false;
+        }
+        WriteCells(0, y, w, row);
+    }
+
+    app_w = w;
+    app_h = h;
+    return true;
+}
+
+static bool LoadV2(const char * path, FILE * file, const u8 * header, size_t size)
+{
+    reader_t reader;
+
+    int version = header[4];
+    int w = header[6] | header[7] << 8;
+    int h = header[8] | header[9] << 8;
+
+    if ( version != 2 ) {
+        printf("'%s' is version %d, this editor reads version 2\n", path, version);
+        return false;
+    }
+
+    if ( !CheckDimensions(path, w, h) ) {
+        return false;
+    }
+
+    reader = (reader_t){ .file = file };
+    fseek(file, V2_HEADER_SIZE, SEEK_SET);
+
+    const u8 * data = NULL;
+#ifndef _WIN32
+    if ( size >= mmap_threshold ) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if ( data == MAP_FAILED ) {
+            data = NULL;
+        } else {
+            reader = (reader_t){
+                .data = data,
+                .position = V2_HEADER_SIZE,
+                .length = size
+            };
+        }
+    }
+#endif
+
+    ClearMap();
+    bool ok = DecodeV2(&reader, w, h);
+
+#ifndef _WIN32
+    if ( data ) {
+        munmap((void *)data, size);
+    }
+#endif
+
+    if ( !ok ) {
+        printf("'%s' is corrupt or truncated\n", path);
+        return false;
+    }
+
+    app_w = w;
+    app_h = h;
+    return true;
+}
+
+bool LoadFile(const char * path)
+{
+    FILE * file = fopen(path, "rb");
+    if ( file == NULL ) {
+        if ( errno == ENOENT ) {
+            printf("'%s' does not exist, it will be created.\n", path);
+        } else {
+            printf("Failed to open '%s': %s\n", path, strerror(errno));
+        }
+        return false;
+    }
+
+    size_t size = 0;
+    if ( fseek(file, 0, SEEK_END) == 0 ) {
+        long end = ftell(file);
+        size = end > 0 ? (size_t)end : 0;
+        rewind(file);
+    }
+
+    u8 header[V2_HEADER_SIZE];
+    size_t header_size = fread(header, 1, sizeof(header), file);
+    bool ok;
+
+    if ( header_size == V2_HEADER_SIZE && memcmp(header, magic, sizeof(magic)) == 0 ) {
+        ok = LoadV2(path, file, header, size);
+    } else if ( header_size >= LEGACY_HEADER_SIZE ) {
+        ok = LoadLegacy(path, file, header, size);
+    } else {
+        printf("'%s' is too short to be a screen file\n", path);
+        ok = false;
+    }
+
+    fclose(file);
+    return ok;
+}
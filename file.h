@@ -0,0 +1,47 @@
+//
+//  file.h
+//  TextAppMaker
+//
+//  Screen files come in two formats:
+//
+//  Legacy: u8 width, u8 height, then width * height cells, row by row, in
+//  host byte order.
+//
+//  Version 2: the 4 byte magic "TAMS", u8 version (2), u8 flags (0), u16
+//  width and u16 height, then each row as a sequence of runs. A run starts
+//  with a control byte: 0x00-0x7F is followed by that many plus one literal
+//  cells, 0x80-0xFF by one cell that repeats (control & 0x7F) + 1 times. Runs
+//  never cross rows. All multi-byte values are little endian.
+//
+
+#ifndef file_h
+#define file_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum {
+    FORMAT_LEGACY,
+    FORMAT_V2,
+};
+
+// Format written by SaveFile. Both are always readable.
+extern int save_format;
+
+// Files at least this big are mapped into memory instead of read with stdio.
+// For small screens the mapping costs more than the read.
+extern size_t mmap_threshold;
+
+/// Write `map` to `path`. The file is written to a temporary file first and
+/// then renamed over `path`, so a failed save never leaves a partial file.
+/// Prints why and returns false on failure.
+bool SaveFile(const char * path);
+
+/// Load `path` into `map`, `app_w` and `app_h`. Version 2 files are decoded
+/// as they are read, without holding the whole file in memory. A file with a
+/// bad header or size leaves the work area as it was. If a version 2 body
+/// turns out to be corrupt, the cells decoded so far are kept but `app_w` and
+/// `app_h` are not changed. Prints why and returns false on failure.
+bool LoadFile(const char * path);
+
+#endif /* file_h */
@@ -0,0 +1,142 @@
+//
+//  fill.c
+//  TextAppMaker
+//
+//  Scanline flood fill with an explicit stack, so canvas size is not limited
+//  by the call stack.
+//
+
+#include "fill.h"
+#include "map.h"
+
+#include <string.h>
+
+static const u16 match_masks[] = {
+    [FILL_MATCH_CELL] = 0xFFFF,
+    [FILL_MATCH_GLYPH] = 0x00FF,
+    [FILL_MATCH_COLOR] = 0xFF00,
+};
+
+// Work buffer of seed points, reused between fills.
+static SDL_Point * seeds;
+static int seeds_capacity;
+
+// Cells already filled. A new cell can still match, so map contents alone
+// can't tell us. Only the filled area is cleared after each fill.
+static u64 filled[MAX_HEIGHT][MAX_WIDTH / 64];
+
+// A row of the new cell, written over each span.
+static u16 span[MAX_WIDTH];
+
+#define IS_FILLED(x, y) (filled[y][(x) / 64] & (1ull << ((x) % 64)))
+
+static bool PushSeed(int * count, int x, int y)
+{
+    if ( *count == seeds_capacity ) {
+        int new_capacity = seeds_capacity ? seeds_capacity * 2 : 256;
+        SDL_Point * new_seeds = realloc(seeds, new_capacity * sizeof(*seeds));
+        if ( new_seeds == NULL ) {
+            return false;
+        }
+        seeds = new_seeds;
+        seeds_capacity = new_capacity;
+    }
+
+    seeds[(*count)++] = (SDL_Point){ x, y };
+    return true;
+}
+
+SDL_Rect FloodFill(int x, int y, u16 new, int match, bool diagonal)
+{
+    SDL_Rect box = { 0, 0, 0, 0 };
+
+    if ( x < 0 || y < 0 || x >= app_w || y >= app_h ) {
+        return box;
+    }
+
+    const u16 mask = match_masks[match];
+    const u16 target = GetCell(x, y) & mask;
+    const int reach = diagonal ? 1 : 0;
+
+    if ( match == FILL_MATCH_CELL && GetCell(x, y) == new ) {
+        return box;
+    }
+
+    for ( int i = 0; i < app_w; i++ ) {
+        span[i] = new;
+    }
+
+    int box_left = x, box_right = x, box_top = y, box_bottom = y;
+    int count = 0;
+    bool ok = PushSeed(&count, x, y);
+
+    while ( ok && count > 0 ) {
+        SDL_Point seed = seeds[--count];
+
+        if ( IS_FILLED(seed.x, seed.y) || (GetCell(seed.x, seed.y) & mask) != target ) {
+            continue;
+        }
+
+        // Extend to the whole span and fill it.
+        int left = seed.x;
+        int right = seed.x;
+        while ( left > 0
+               && !IS_FILLED(left - 1, seed.y)
+               && (GetCell(left - 1, seed.y) & mask) == target ) {
+            left--;
+        }
+        while ( right < app_w - 1
+               && !IS_FILLED(right + 1, seed.y)
+               && (GetCell(right + 1, seed.y) & mask) == target ) {
+            right++;
+        }
+
+        WriteCells(left, seed.y, right - left + 1, span);
+        for ( int fx = left; fx <= right; fx++ ) {
+            filled[seed.y][fx / 64] |= 1ull << (fx % 64);
+        }
+
+        box_left = MIN(box_left, left);
+        box_right = MAX(box_right, right);
+        box_top = MIN(box_top, seed.y);
+        box_bottom = MAX(box_bottom, seed.y);
+
+        // Seed each fillable run in the rows above and below.
+        int scan_left = MAX(left - reach, 0);
+        int scan_right = MIN(right + reach, app_w - 1);
+
+        for ( int dy = -1; ok && dy <= 1; dy += 2 ) {
+            int ny = seed.y + dy;
+            if ( ny < 0 || ny >= app_h ) {
+                continue;
+            }
+
+            bool in_run = false;
+
+            for ( int nx = scan_left; nx <= scan_right; nx++ ) {
+                bool fillable = !IS_FILLED(nx, ny) && (GetCell(nx, ny) & mask) == target;
+                if ( fillable && !in_run && !(ok = PushSeed(&count, nx, ny)) ) {
+                    printf("FloodFill: out of memory, fill is incomplete\n");
+                    break;
+                }
+                in_run = fillable;
+            }
+        }
+    }
+
+    box = (SDL_Rect){
+        box_left,
+        box_top,
+        box_right - box_left + 1,
+        box_bottom - box_top + 1
+    };
+
+    for ( int fy = box_top; fy <= box_bottom; fy++ ) {
+        memset(&filled[fy][box_left / 64],
+               0,
+               (box_right / 64 - box_left / 64 + 1) * sizeof(u64));
+    }
+    MarkDirtyRect(box);
+
+    return box;
+}
@@ -0,0 +1,23 @@
+//
+//  fill.h
+//  TextAppMaker
+//
+
+#ifndef fill_h
+#define fill_h
+
+#include "common.h"
+#include <stdbool.h>
+
+// Which parts of a cell must equal the start cell's for it to be filled.
+enum {
+    FILL_MATCH_CELL,
+    FILL_MATCH_GLYPH,
+    FILL_MATCH_COLOR,
+};
+
+/// Fill the area connected to map cell x, y with `new`, 4-way or, if
+/// `diagonal`, 8-way. Marks the touched area dirty and returns it.
+SDL_Rect FloodFill(int x, int y, u16 new, int match, bool diagonal);
+
+#endif /* fill_h */
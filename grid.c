@@ -0,0 +1,144 @@
+//
+//  grid.c
+//  TextAppMaker
+//
+
+#include "grid.h"
+#include "text.h"
+
+#define SOLID_GLYPH 219 // Full block, used to texture background quads.
+
+// Persistent buffers. They only grow, so a steady-state frame allocates
+// nothing. The index pattern is the same for every quad and is only written
+// when the buffer grows.
+static SDL_Vertex * vertices;
+static int * indices;
+static int quad_capacity;
+
+static bool ReserveQuads(int count)
+{
+    if ( count <= quad_capacity ) {
+        return true;
+    }
+
+    int new_capacity = quad_capacity ? quad_capacity : 1024;
+    while ( new_capacity < count ) {
+        new_capacity *= 2;
+    }
+
+    SDL_Vertex * new_vertices = realloc(vertices, new_capacity * 4 * sizeof(*vertices));
+    if ( new_vertices == NULL ) {
+        return false;
+    }
+    vertices = new_vertices;
+
+    int * new_indices = realloc(indices, new_capacity * 6 * sizeof(*indices));
+    if ( new_indices == NULL ) {
+        return false;
+    }
+    indices = new_indices;
+
+    for ( int q = quad_capacity; q < new_capacity; q++ ) {
+        int * i = &indices[q * 6];
+        int v = q * 4;
+        i[0] = v + 0; i[1] = v + 1; i[2] = v + 2;
+        i[3] = v + 2; i[4] = v + 1; i[5] = v + 3;
+    }
+
+    quad_capacity = new_capacity;
+    return true;
+}
+
+static void SetQuad(SDL_Vertex * v, float x, float y, unsigned char glyph, SDL_Color color)
+{
+    const float atlas_w = 16 * FONT_W;
+    const float atlas_h = 16 * FONT_H;
+
+    float u0 = (glyph % 16) * FONT_W / atlas_w;
+    float v0 = (glyph / 16) * FONT_H / atlas_h;
+    float u1 = u0 + FONT_W / atlas_w;
+    float v1 = v0 + FONT_H / atlas_h;
+
+    color.a = 255;
+
+    v[0] = (SDL_Vertex){ { x,          y          }, color, { u0, v0 } };
+    v[1] = (SDL_Vertex){ { x + FONT_W, y          }, color, { u1, v0 } };
+    v[2] = (SDL_Vertex){ { x,          y + FONT_H }, color, { u0, v1 } };
+    v[3] = (SDL_Vertex){ { x + FONT_W, y + FONT_H }, color, { u1, v1 } };
+}
+
+// One fill and one glyph per cell, for when there is no atlas or the
+// renderer can't do geometry.
+static void RenderCellsSlow(const u16 * cells, int pitch, SDL_Rect region, int dst_x, int dst_y)
+{
+    for ( int y = 0; y < region.h; y++ ) {
+        const u16 * row = &cells[(region.y + y) * pitch + region.x];
+
+        for ( int x = 0; x < region.w; x++ ) {
+            SDL_Rect r = { dst_x + x * FONT_W, dst_y + y * FONT_H, FONT_W, FONT_H };
+            SDL_Color bg = palette[GET_BG(row[x])];
+            SDL_Color fg = palette[GET_FG(row[x])];
+
+            SDL_SetRenderDrawColor(renderer, bg.r, bg.g, bg.b, 255);
+            SDL_RenderFillRect(renderer, &r);
+            SDL_SetRenderDrawColor(renderer, fg.r, fg.g, fg.b, 255);
+            PrintChar(r.x, r.y, GET_CHAR(row[x]));
+        }
+    }
+}
+
+void RenderCells(const u16 * cells, int pitch, SDL_Rect region, int dst_x, int dst_y)
+{
+    if ( region.w <= 0 || region.h <= 0 ) {
+        return;
+    }
+
+    SDL_Texture * atlas = GlyphAtlas();
+    if ( atlas == NULL || !ReserveQuads(region.w * region.h * 2) ) {
+        RenderCellsSlow(cells, pitch, region, dst_x, dst_y);
+        return;
+    }
+
+    // Backgrounds first, then glyphs, so glyphs always draw on top.
+    SDL_Vertex * v = vertices;
+    for ( int y = 0; y < region.h; y++ ) {
+        const u16 * row = &cells[(region.y + y) * pitch + region.x];
+        float ry = dst_y + y * FONT_H;
+
+        for ( int x = 0; x < region.w; x++ ) {
+            SetQuad(v, dst_x + x * FONT_W, ry, SOLID_GLYPH, palette[GET_BG(row[x])]);
+            v += 4;
+        }
+    }
+
+    for ( int y = 0; y < region.h; y++ ) {
+        const u16 * row = &cells[(region.y + y) * pitch + region.x];
+        float ry = dst_y + y * FONT_H;
+
+        for ( int x = 0; x < region.w; x++ ) {
+            u8 ch = GET_CHAR(row[x]);
+            if ( GlyphIsBlank(ch) || GET_FG(row[x]) == GET_BG(row[x]) ) {
+                continue;
+            }
+            SetQuad(v, dst_x + x * FONT_W, ry, ch, palette[GET_FG(row[x])]);
+            v += 4;
+        }
+    }
+
+    int num_quads = (int)(v - vertices) / 4;
+    SDL_SetTextureColorMod(atlas, 255, 255, 255);
+    SDL_SetTextureAlphaMod(atlas, 255);
+
+    if ( SDL_RenderGeometry(renderer, atlas, vertices, num_quads * 4, indices, num_quads * 6) ) {
+        RenderCellsSlow(cells, pitch, region, dst_x, dst_y);
+    }
+}
+
+void FreeGrid(void)
+{
+    free(vertices);
+    free(indices);
+    vertices = NULL;
+    indices = NULL;
+    quad_capacity = 0;
+}
@@ -0,0 +1,20 @@
+//
+//  grid.h
+//  TextAppMaker
+//
+//  Batched cell renderer: background and glyph quads for a rectangle of cells
+//  submitted in a single SDL_RenderGeometry call.
+//
+
+#ifndef grid_h
+#define grid_h
+
+#include "common.h"
+
+/// Draw the cells in `region` of a `pitch`-wide cell array so that the
+/// region's top-left cell lands at pixel (dst_x, dst_y).
+void RenderCells(const u16 * cells, int pitch, SDL_Rect region, int dst_x, int dst_y);
+
+void FreeGrid(void);
+
+#endif /* grid_h */
@@ -0,0 +1,247 @@
+//
+//  image.c
+//  TextAppMaker
+//
+
+#include "image.h"
+#include "cp437.h"
+#include "map.h"
+#include "png.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_THREADS 64
+
+typedef struct {
+    const u16 * cells;
+    int w;
+    int scale;
+    int format;
+    int top;            // Cell rows
+    int bottom;
+    bool last;
+
+    u8 * rgb;           // PPM: where this band goes in the whole image
+    png_part_t part;    // PNG: the band compressed
+    bool ok;
+} band_t;
+
+// Rasterize glyph row `row` of the cells in `cells` as one palette index per
+// pixel, at 1x.
+static void RasterLine(u8 * line, const u16 * cells, int w, int row)
+{
+    for ( int x = 0; x < w; x++ ) {
+        u16 cell = cells[x];
+        u8 bits = cp437[GET_CHAR(cell) * FONT_H + row];
+        u8 fg = GET_FG(cell);
+        u8 bg = GET_BG(cell);
+
+        for ( int i = 0; i < FONT_W; i++ ) {
+            line[x * FONT_W + i] = bits & (0x80 >> i) ? fg : bg;
+        }
+    }
+}
+
+static int RenderBand(void * data)
+{
+    band_t * band = data;
+    int s = band->scale;
+    int line_w = band->w * FONT_W;
+    int pixel_w = line_w * s;
+    int rows = (band->bottom - band->top) * FONT_H * s;
+
+    // PNG rows: a filter byte and two pixels per byte.
+    size_t png_row = 1 + (size_t)(pixel_w + 1) / 2;
+    size_t rgb_row = (size_t)pixel_w * 3;
+
+    u8 * line = malloc(line_w);
+    u8 * raw = band->format == IMAGE_PNG ? malloc(png_row * rows) : NULL;
+    if ( line == NULL || (band->format == IMAGE_PNG && raw == NULL) ) {
+        free(line);
+        free(raw);
+        return 0;
+    }
+
+    u8 rgb[16][3];
+    for ( int i = 0; i < 16; i++ ) {
+        rgb[i][0] = palette[i].r;
+        rgb[i][1] = palette[i].g;
+        rgb[i][2] = palette[i].b;
+    }
+
+    u8 * out = band->format == IMAGE_PNG ? raw : band->rgb;
+    size_t out_row = band->format == IMAGE_PNG ? png_row : rgb_row;
+
+    for ( int y = band->top; y < band->bottom; y++ ) {
+        for ( int row = 0; row < FONT_H; row++ ) {
+            RasterLine(line, &band->cells[y * band->w], band->w, row);
+
+            if ( band->format == IMAGE_PNG ) {
+                // Pixels scaled across and packed two to a byte. With
+                // filter "none"; the copies below use "up", which makes
+                // them all zero.
+                // Lines are a whole number of glyphs wide, so always even.
+                out[0] = 0;
+                u8 * p = out + 1;
+                if ( s == 1 ) {
+                    for ( int x = 0; x < line_w; x += 2 ) {
+                        *p++ = line[x] << 4 | line[x + 1];
+                    }
+                } else if ( s % 2 == 0 ) {
+                    for ( int x = 0; x < line_w; x++ ) {
+                        memset(p, line[x] * 0x11, s / 2);
+                        p += s / 2;
+                    }
+                } else {
+                    memset(p, 0, png_row - 1);
+                    int px = 0;
+                    for ( int x = 0; x < line_w; x++ ) {
+                        for ( int i = 0; i < s; i++, px++ ) {
+                            p[px >> 1] |= px & 1 ? line[x] : line[x] << 4;
+                        }
+                    }
+                }
+            } else {
+                u8 * p = out;
+                for ( int x = 0; x < line_w; x++ ) {
+                    for ( int i = 0; i < s; i++ ) {
+                        memcpy(p, rgb[line[x]], 3);
+                        p += 3;
+                    }
+                }
+            }
+
+            for ( int i = 1; i < s; i++ ) {
+                u8 * copy = out + out_row * i;
+                if ( band->format == IMAGE_PNG ) {
+                    memset(copy, 0, png_row);
+                    copy[0] = 2;
+                } else {
+                    memcpy(copy, out, rgb_row);
+                }
+            }
+
+            out += out_row * s;
+        }
+    }
+
+    band->ok = true;
+    if ( band->format == IMAGE_PNG ) {
+        band->ok = CompressPart(&band->part, raw, png_row * rows, band->last);
+    }
+
+    free(line);
+    free(raw);
+    return 0;
+}
+
+bool WriteImage(const char * path,
+                int format,
+                const u16 * cells,
+                int w,
+                int h,
+                int scale,
+                int threads)
+{
+    CLAMP(scale, 1, MAX_IMAGE_SCALE);
+    threads = MAX(1, MIN(threads, MIN(h, MAX_THREADS)));
+
+    int pixel_w = w * FONT_W * scale;
+    int pixel_h = h * FONT_H * scale;
+
+    u8 * rgb = NULL;
+    if ( format == IMAGE_PPM ) {
+        rgb = malloc((size_t)pixel_w * pixel_h * 3);
+        if ( rgb == NULL ) {
+            printf("Failed to export '%s': out of memory\n", path);
+            return false;
+        }
+    }
+
+    band_t bands[MAX_THREADS];
+    SDL_Thread * thread[MAX_THREADS];
+    for ( int i = 0; i < threads; i++ ) {
+        int top = h * i / threads;
+        bands[i] = (band_t){
+            .cells = cells,
+            .w = w,
+            .scale = scale,
+            .format = format,
+            .top = top,
+            .bottom = h * (i + 1) / threads,
+            .last = i == threads - 1,
+            .rgb = rgb ? rgb + (size_t)top * FONT_H * scale * pixel_w * 3 : NULL,
+        };
+
+        // The calling thread takes the last band.
+        thread[i] = NULL;
+        if ( i < threads - 1 ) {
+            thread[i] = SDL_CreateThread(RenderBand, "image", &bands[i]);
+        }
+        if ( thread[i] == NULL ) {
+            RenderBand(&bands[i]);
+        }
+    }
+
+    bool ok = true;
+    for ( int i = 0; i < threads; i++ ) {
+        if ( thread[i] ) {
+            SDL_WaitThread(thread[i], NULL);
+        }
+        ok = ok && bands[i].ok;
+    }
+
+    FILE * file = ok ? fopen(path, "wb") : NULL;
+    if ( !ok ) {
+        printf("Failed to export '%s': out of memory\n", path);
+    } else if ( file == NULL ) {
+        printf("Failed to create '%s': %s\n", path, strerror(errno));
+        ok = false;
+    } else {
+        if ( format == IMAGE_PNG ) {
+            png_part_t parts[MAX_THREADS];
+            for ( int i = 0; i < threads; i++ ) {
+                parts[i] = bands[i].part;
+            }
+            ok = WritePNG(file, pixel_w, pixel_h, parts, threads);
+        } else {
+            size_t size = (size_t)pixel_w * pixel_h * 3;
+            ok = fprintf(file, "P6\n%d %d\n255\n", pixel_w, pixel_h) > 0
+                && fwrite(rgb, 1, size, file) == size;
+        }
+
+        if ( fclose(file) != 0 ) {
+            ok = false;
+        }
+        if ( !ok ) {
+            printf("Failed to write '%s'\n", path);
+        }
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        FreePart(&bands[i].part);
+    }
+    free(rgb);
+
+    return ok;
+}
+
+bool ExportImage(const char * path, int format, int scale)
+{
+    u16 * cells = malloc((size_t)app_w * app_h * sizeof(*cells));
+    if ( cells == NULL ) {
+        printf("Failed to export '%s': out of memory\n", path);
+        return false;
+    }
+
+    for ( int y = 0; y < app_h; y++ ) {
+        ReadCells(0, y, app_w, &cells[y * app_w]);
+    }
+
+    bool ok = WriteImage(path, format, cells, app_w, app_h, scale, SDL_GetCPUCount());
+    free(cells);
+    return ok;
+}
@@ -0,0 +1,36 @@
+//
+//  image.h
+//  TextAppMaker
+//
+//  Renders screens to image files without a window, using the CP437 font
+//  and the palette. Rows of cells are split into bands, one per thread.
+//
+
+#ifndef image_h
+#define image_h
+
+#include "common.h"
+#include <stdbool.h>
+
+#define MAX_IMAGE_SCALE 8
+
+enum {
+    IMAGE_PPM,  // Binary RGB (P6)
+    IMAGE_PNG,  // 4-bit paletted
+};
+
+/// Write the w x h `cells` as an image with each pixel `scale` x `scale`,
+/// using up to `threads` threads. Safe to call from several threads at
+/// once. Prints why and returns false on failure.
+bool WriteImage(const char * path,
+                int format,
+                const u16 * cells,
+                int w,
+                int h,
+                int scale,
+                int threads);
+
+/// Write the work area as an image, using every CPU.
+bool ExportImage(const char * path, int format, int scale);
+
+#endif /* image_h */
@@ -0,0 +1,487 @@
+//
+//  import.c
+//  TextAppMaker
+//
+
+#include "import.h"
+#include "map.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SAUCE_SIZE 128
+#define DEFAULT_WIDTH 80
+#define MAX_PARAMS 16
+
+// Palette index for ANSI color number 0-7 (and back again: the mapping is
+// its own inverse).
+static const u8 palette_index[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+enum {
+    BYTE_GLYPH,
+    BYTE_CR,
+    BYTE_LF,
+    BYTE_TAB,
+    BYTE_ESC,
+    BYTE_EOF,   // Ctrl-Z, which precedes SAUCE
+};
+
+enum {
+    STATE_TEXT,
+    STATE_ESC,
+    STATE_CSI,
+};
+
+typedef struct {
+    int width;
+    bool ice_colors;
+
+    int x;
+    int y;
+    int saved_x;
+    int saved_y;
+    int rows;       // Rows drawn into so far
+
+    int fg;
+    int bg;
+    bool bold;
+    bool blink;
+    bool reverse;
+    u16 attr;       // The colors above as cell bits
+
+    int state;
+    int params[MAX_PARAMS];
+    int num_params;
+
+    // The row under the cursor, written back when the cursor leaves it.
+    int row_y;
+    int dirty_left;
+    int dirty_right;
+} parser_t;
+
+static u8 byte_class[256];
+static u16 row[MAX_WIDTH];
+static u8 read_chunk[64 * 1024];
+
+static void InitByteClasses(void)
+{
+    byte_class['\r'] = BYTE_CR;
+    byte_class['\n'] = BYTE_LF;
+    byte_class['\t'] = BYTE_TAB;
+    byte_class[0x1B] = BYTE_ESC;
+    byte_class[0x1A] = BYTE_EOF;
+}
+
+static void FlushRow(parser_t * p)
+{
+    if ( p->dirty_left <= p->dirty_right ) {
+        WriteCells(p->dirty_left,
+                   p->row_y,
+                   p->dirty_right - p->dirty_left + 1,
+                   &row[p->dirty_left]);
+    }
+
+    p->dirty_left = MAX_WIDTH;
+    p->dirty_right = -1;
+}
+
+// Make `row` hold the row the cursor is on.
+static void LoadRow(parser_t * p)
+{
+    if ( p->y == p->row_y ) {
+        return;
+    }
+
+    FlushRow(p);
+    p->row_y = p->y;
+
+    // Rows not drawn into yet are still blank from ClearMap.
+    if ( p->y < p->rows ) {
+        ReadCells(0, p->y, p->width, row);
+    } else {
+        memset(row, 0, p->width * sizeof(*row));
+    }
+}
+
+static void UpdateAttr(parser_t * p)
+{
+    int fg = p->fg | (p->bold ? 8 : 0);
+    int bg = p->bg | (p->blink && p->ice_colors ? 8 : 0);
+    if ( p->reverse ) {
+        int temp = fg;
+        fg = bg;
+        bg = temp;
+    }
+
+    p->attr = (u16)(bg << 12 | fg << 8);
+}
+
+static void NewLine(parser_t * p)
+{
+    p->x = 0;
+    p->y = MIN(p->y + 1, MAX_HEIGHT);
+}
+
+static void Graphics(parser_t * p)
+{
+    if ( p->num_params == 0 ) {
+        p->params[p->num_params++] = 0;
+    }
+
+    for ( int i = 0; i < p->num_params; i++ ) {
+        int n = p->params[i];
+
+        if ( n == 0 ) {
+            p->fg = 7;
+            p->bg = 0;
+            p->bold = p->blink = p->reverse = false;
+        } else if ( n == 1 ) {
+            p->bold = true;
+        } else if ( n == 5 || n == 6 ) {
+            p->blink = true;
+        } else if ( n == 7 ) {
+            p->reverse = true;
+        } else if ( n == 22 ) {
+            p->bold = false;
+        } else if ( n == 25 ) {
+            p->blink = false;
+        } else if ( n == 27 ) {
+            p->reverse = false;
+        } else if ( n >= 30 && n <= 37 ) {
+            p->fg = palette_index[n - 30];
+        } else if ( n == 39 ) {
+            p->fg = 7;
+        } else if ( n >= 40 && n <= 47 ) {
+            p->bg = palette_index[n - 40];
+        } else if ( n == 49 ) {
+            p->bg = 0;
+        } else if ( n >= 90 && n <= 97 ) {
+            p->fg = palette_index[n - 90] + 8;
+        } else if ( n >= 100 && n <= 107 ) {
+            p->bg = palette_index[n - 100] + 8;
+        } else if ( n == 38 || n == 48 ) {
+            break; // 256-color and RGB colors aren't representable.
+        }
+    }
+
+    UpdateAttr(p);
+}
+
+static void EraseRow(parser_t * p, int x1, int x2)
+{
+    if ( p->y >= MAX_HEIGHT ) {
+        return;
+    }
+
+    LoadRow(p);
+    x1 = MAX(x1, 0);
+    x2 = MIN(x2, p->width - 1);
+
+    for ( int x = x1; x <= x2; x++ ) {
+        row[x] = 0;
+    }
+
+    if ( x1 <= x2 ) {
+        p->dirty_left = MIN(p->dirty_left, x1);
+        p->dirty_right = MAX(p->dirty_right, x2);
+    }
+}
+
+// Run the CSI sequence ending in `final`.
+static void Control(parser_t * p, u8 final)
+{
+    int n = p->num_params > 0 && p->params[0] > 0 ? p->params[0] : 1;
+
+    switch ( final ) {
+        case 'A':
+            p->y = MAX(p->y - n, 0);
+            break;
+        case 'B':
+            p->y = MIN(p->y + n, MAX_HEIGHT - 1);
+            break;
+        case 'C':
+            p->x = MIN(p->x + n, p->width - 1);
+            break;
+        case 'D':
+            p->x = MAX(p->x - n, 0);
+            break;
+        case 'H':
+        case 'f':
+            p->y = MIN(n, MAX_HEIGHT) - 1;
+            p->x = p->num_params > 1 && p->params[1] > 0 ? p->params[1] - 1 : 0;
+            p->x = MIN(p->x, p->width - 1);
+            break;
+        case 'J':
+            if ( p->num_params > 0 && p->params[0] == 2 ) {
+                FlushRow(p);
+                ClearMap();
+                p->row_y = -1;
+                p->rows = 0;
+                p->x = 0;
+                p->y = 0;
+            }
+            break;
+        case 'K':
+            if ( p->num_params == 0 || p->params[0] == 0 ) {
+                EraseRow(p, p->x, p->width - 1);
+            } else if ( p->params[0] == 1 ) {
+                EraseRow(p, 0, p->x);
+            } else {
+                EraseRow(p, 0, p->width - 1);
+            }
+            break;
+        case 'm':
+            Graphics(p);
+            break;
+        case 's':
+            p->saved_x = p->x;
+            p->saved_y = p->y;
+            break;
+        case 'u':
+            p->x = p->saved_x;
+            p->y = p->saved_y;
+            break;
+        default:
+            break; // Ignore the rest.
+    }
+}
+
+// Decode `size` bytes. Returns false once the end of file character is
+// reached.
+static bool Parse(parser_t * p, const u8 * data, size_t size)
+{
+    const u8 * end = data + size;
+
+    while ( data < end ) {
+        if ( p->state == STATE_TEXT ) {
+            u8 byte = *data++;
+
+            switch ( byte_class[byte] ) {
+                case BYTE_GLYPH: {
+                    // Like a terminal, wrap only once there's something to
+                    // put on the next row, so a full row followed by CR LF
+                    // doesn't leave an empty one.
+                    if ( p->x >= p->width ) {
+                        NewLine(p);
+                    }
+
+                    if ( p->y >= MAX_HEIGHT ) {
+                        break;
+                    }
+
+                    // Copy the run of glyphs that fits on this row.
+                    // Locals, as stores to `row` could alias `p`.
+                    LoadRow(p);
+                    int x = p->x;
+                    u16 attr = p->attr;
+                    const u8 * run_end = data + MIN(end - data, p->width - x - 1);
+                    row[x++] = attr | byte;
+
+                    for ( ;; ) {
+#ifdef __SSE2__
+                        // 16 at a time while there are no bytes below 0x20,
+                        // which is where all the special ones are.
+                        __m128i attrs = _mm_set1_epi16((short)attr);
+                        __m128i zero = _mm_setzero_si128();
+                        __m128i max_control = _mm_set1_epi8(0x1F);
+
+                        while ( run_end - data >= 16 ) {
+                            __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+                            __m128i low = _mm_min_epu8(bytes, max_control);
+                            if ( _mm_movemask_epi8(_mm_cmpeq_epi8(low, bytes)) ) {
+                                break;
+                            }
+
+                            _mm_storeu_si128((__m128i *)&row[x],
+                                             _mm_or_si128(_mm_unpacklo_epi8(bytes, zero), attrs));
+                            _mm_storeu_si128((__m128i *)&row[x + 8],
+                                             _mm_or_si128(_mm_unpackhi_epi8(bytes, zero), attrs));
+                            data += 16;
+                            x += 16;
+                        }
+#endif
+                        if ( data == run_end || byte_class[*data] != BYTE_GLYPH ) {
+                            break;
+                        }
+                        row[x++] = attr | *data++;
+                    }
+
+                    p->dirty_left = MIN(p->dirty_left, p->x);
+                    p->dirty_right = MAX(p->dirty_right, x - 1);
+                    p->rows = MAX(p->rows, p->y + 1);
+                    p->x = x;
+                    break;
+                }
+                case BYTE_CR:
+                    p->x = 0;
+                    break;
+                case BYTE_LF:
+                    NewLine(p);
+                    break;
+                case BYTE_TAB: {
+                    int tab_stop = (p->x + 8) & ~7;
+                    p->x = MIN(tab_stop, p->width - 1);
+                    break;
+                }
+                case BYTE_ESC:
+                    p->state = STATE_ESC;
+                    break;
+                case BYTE_EOF:
+                    return false;
+            }
+        } else if ( p->state == STATE_ESC ) {
+            if ( *data++ == '[' ) {
+                p->state = STATE_CSI;
+                p->num_params = 0;
+                p->params[0] = 0;
+            } else {
+                p->state = STATE_TEXT;
+            }
+        } else {
+            u8 byte = *data++;
+
+            if ( byte >= '0' && byte <= '9' ) {
+                if ( p->num_params == 0 ) {
+                    p->num_params = 1;
+                }
+                int * param = &p->params[p->num_params - 1];
+                *param = MIN(*param * 10 + (byte - '0'), 99999);
+            } else if ( byte == ';' ) {
+                if ( p->num_params == 0 ) {
+                    p->num_params = 1; // Empty first parameter
+                }
+                if ( p->num_params < MAX_PARAMS ) {
+                    p->params[p->num_params++] = 0;
+                }
+            } else if ( byte >= 0x40 && byte <= 0x7E ) {
+                Control(p, byte);
+                p->state = STATE_TEXT;
+            } else if ( byte < 0x20 || byte > 0x7E ) {
+                p->state = STATE_TEXT; // Malformed
+            }
+            // Anything else is a private marker such as '?', ignored.
+        }
+    }
+
+    return true;
+}
+
+static void CopyField(char * dst, const u8 * src, int length)
+{
+    memcpy(dst, src, length);
+    dst[length] = '\0';
+
+    // SAUCE pads with spaces.
+    while ( length > 0 && (dst[length - 1] == ' ' || dst[length - 1] == '\0') ) {
+        dst[--length] = '\0';
+    }
+}
+
+// Read the SAUCE record if the file has one. Returns the size of the data
+// before it.
+static long ReadSauce(FILE * file, long size, sauce_t * sauce)
+{
+    u8 record[SAUCE_SIZE];
+    *sauce = (sauce_t){ 0 };
+
+    if ( size < SAUCE_SIZE
+        || fseek(file, size - SAUCE_SIZE, SEEK_SET) != 0
+        || fread(record, 1, SAUCE_SIZE, file) != SAUCE_SIZE
+        || memcmp(record, "SAUCE00", 7) != 0 )
+    {
+        rewind(file);
+        return size;
+    }
+
+    CopyField(sauce->title, record + 7, 35);
+    CopyField(sauce->author, record + 42, 20);
+    CopyField(sauce->group, record + 62, 20);
+
+    // Width and height are only meaningful for character files.
+    int data_type = record[94];
+    if ( data_type == 1 || data_type == 0 ) {
+        sauce->width = record[96] | record[97] << 8;
+        sauce->height = record[98] | record[99] << 8;
+    }
+    sauce->ice_colors = record[105] & 1;
+
+    // A comment block of 64 byte lines may sit before the record.
+    long data_size = size - SAUCE_SIZE;
+    int comments = record[104];
+    if ( comments > 0 ) {
+        data_size -= 5 + comments * 64;
+    }
+
+    rewind(file);
+    return MAX(data_size, 0);
+}
+
+bool ImportANSI(const char * path, sauce_t * sauce)
+{
+    FILE * file = fopen(path, "rb");
+    if ( file == NULL ) {
+        printf("Failed to open '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+
+    long size = 0;
+    if ( fseek(file, 0, SEEK_END) == 0 ) {
+        size = MAX(ftell(file), 0);
+    }
+
+    sauce_t record;
+    long data_size = ReadSauce(file, size, &record);
+
+    if ( byte_class[0x1B] != BYTE_ESC ) {
+        InitByteClasses();
+    }
+
+    parser_t p = {
+        .width = record.width > 0 ? MIN(record.width, MAX_WIDTH) : DEFAULT_WIDTH,
+        .ice_colors = record.ice_colors,
+        .fg = 7,
+        .row_y = -1,
+        .dirty_left = MAX_WIDTH,
+        .dirty_right = -1,
+    };
+    UpdateAttr(&p);
+    ClearMap();
+
+    bool read_error = false;
+    while ( data_size > 0 ) {
+        size_t n = fread(read_chunk, 1, MIN((size_t)data_size, sizeof(read_chunk)), file);
+        if ( n == 0 ) {
+            read_error = ferror(file);
+            break;
+        }
+
+        data_size -= n;
+        if ( !Parse(&p, read_chunk, n) ) {
+            break;
+        }
+    }
+
+    FlushRow(&p);
+    fclose(file);
+
+    if ( read_error ) {
+        printf("Failed to read '%s'\n", path);
+        return false;
+    }
+
+    int height = record.height > 0 ? record.height : p.rows;
+    CLAMP(height, 1, MAX_HEIGHT);
+    app_w = p.width;
+    app_h = height;
+
+    if ( sauce ) {
+        *sauce = record;
+    }
+
+    return true;
+}
@@ -0,0 +1,31 @@
+//
+//  import.h
+//  TextAppMaker
+//
+//  Reads ANSI art: CP437 text with the common CSI escape sequences (cursor
+//  movement, save/restore, erase, SGR colors), and the SAUCE record at the
+//  end of the file if there is one. The file is decoded straight into the
+//  map as it is read.
+//
+
+#ifndef import_h
+#define import_h
+
+#include <stdbool.h>
+
+typedef struct {
+    char title[36];
+    char author[21];
+    char group[21];
+    int width;          // 0 if not given
+    int height;         // 0 if not given
+    bool ice_colors;    // Blink selects bright backgrounds
+} sauce_t;
+
+/// Replace the work area with the ANSI file at `path`. The width is taken
+/// from its SAUCE record, or is 80; the height from SAUCE, or however many
+/// rows were drawn. If `sauce` isn't NULL it receives the record, which is
+/// all zero if the file has none. Prints why and returns false on failure.
+bool ImportANSI(const char * path, sauce_t * sauce);
+
+#endif /* import_h */
@@ -0,0 +1,472 @@
+//
+//  input.c
+//  TextAppMaker
+//
+
+#include "input.h"
+#include "map.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_MAGIC "TAMI"
+#define INPUT_VERSION 1
+
+enum {
+    REC_SAMPLE      = 'S',
+    REC_NONE        = 'N',
+    REC_QUIT        = 'Q',
+    REC_KEY_DOWN    = 'K',
+    REC_KEY_UP      = 'k',
+    REC_BUTTON_DOWN = 'B',
+    REC_BUTTON_UP   = 'b',
+    REC_MOTION      = 'M',
+    REC_WHEEL       = 'W',
+    REC_TEXT        = 'T',
+    REC_WINDOW      = 'V',
+    REC_OTHER       = 'O',
+};
+
+int input_mode = INPUT_LIVE;
+
+static FILE * input_file;
+static const char * input_path;
+
+// The frame's sample.
+static u32 sample_ticks;
+static int sample_x;
+static int sample_y;
+static u32 sample_buttons;
+static SDL_Keymod sample_mods;
+
+// Replay timing: how long each frame took, from one sample to the next.
+static float * frame_ms;
+static int num_frames;
+static int frames_allocated;
+static int num_events;
+static u64 replay_start;
+static u64 last_sample;
+static bool replay_ended; // Ran out of recording rather than quit
+
+// Work area hash, so a replay can tell it isn't starting from the same screen.
+static u32 HashWorkArea(void)
+{
+    u32 hash = 2166136261u;
+    u16 row[MAX_WIDTH];
+    for ( int y = 0; y < app_h; y++ ) {
+        ReadCells(0, y, app_w, row);
+        const u8 * bytes = (const u8 *)row;
+        for ( int i = 0; i < app_w * 2; i++ ) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+static void Put8(u8 value)
+{
+    fputc(value, input_file);
+}
+
+static void Put16(u16 value)
+{
+    Put8(value & 0xFF);
+    Put8(value >> 8);
+}
+
+static void Put32(u32 value)
+{
+    Put16(value & 0xFFFF);
+    Put16(value >> 16);
+}
+
+static void WriteEvent(const SDL_Event * event)
+{
+    switch ( event->type ) {
+        case SDL_QUIT:
+            Put8(REC_QUIT);
+            break;
+
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            Put8(event->type == SDL_KEYDOWN ? REC_KEY_DOWN : REC_KEY_UP);
+            Put32((u32)event->key.keysym.sym);
+            Put16((u16)event->key.keysym.scancode);
+            Put16(event->key.keysym.mod);
+            Put8(event->key.repeat);
+            break;
+
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            Put8(event->type == SDL_MOUSEBUTTONDOWN
+                 ? REC_BUTTON_DOWN
+                 : REC_BUTTON_UP);
+            Put8(event->button.button);
+            Put8(event->button.clicks);
+            Put16((u16)event->button.x);
+            Put16((u16)event->button.y);
+            break;
+
+        case SDL_MOUSEMOTION:
+            Put8(REC_MOTION);
+            Put8((u8)event->motion.state);
+            Put16((u16)event->motion.x);
+            Put16((u16)event->motion.y);
+            Put16((u16)event->motion.xrel);
+            Put16((u16)event->motion.yrel);
+            break;
+
+        case SDL_MOUSEWHEEL:
+            Put8(REC_WHEEL);
+            Put16((u16)event->wheel.x);
+            Put16((u16)event->wheel.y);
+            break;
+
+        case SDL_TEXTINPUT: {
+            size_t len = strlen(event->text.text);
+            Put8(REC_TEXT);
+            Put8((u8)len);
+            fwrite(event->text.text, 1, len, input_file);
+            break;
+        }
+
+        case SDL_WINDOWEVENT:
+            Put8(REC_WINDOW);
+            Put8(event->window.event);
+            Put32((u32)event->window.data1);
+            Put32((u32)event->window.data2);
+            break;
+
+        default:
+            Put8(REC_OTHER);
+            Put32(event->type);
+            break;
+    }
+}
+
+bool StartRecording(const char * path)
+{
+    input_file = fopen(path, "wb");
+    if ( input_file == NULL ) {
+        printf("Failed to create '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+
+    fwrite(INPUT_MAGIC, 1, 4, input_file);
+    Put8(INPUT_VERSION);
+    Put16(app_w);
+    Put16(app_h);
+    Put32(HashWorkArea());
+
+    input_path = path;
+    input_mode = INPUT_RECORD;
+    return true;
+}
+
+static u8 Get8(void)
+{
+    int c = fgetc(input_file);
+    return c == EOF ? 0 : c;
+}
+
+static u16 Get16(void)
+{
+    u16 low = Get8();
+    return low | Get8() << 8;
+}
+
+static u32 Get32(void)
+{
+    u32 low = Get16();
+    return low | (u32)Get16() << 16;
+}
+
+// Read the next record into `event`. Returns its tag, or EOF at the end of the
+// recording.
+static int ReadRecord(SDL_Event * event)
+{
+    int tag = fgetc(input_file);
+    if ( tag == EOF ) {
+        return EOF;
+    }
+
+    memset(event, 0, sizeof(*event));
+    event->common.timestamp = sample_ticks;
+
+    switch ( tag ) {
+        case REC_SAMPLE:
+            sample_ticks = Get32();
+            sample_x = (s16)Get16();
+            sample_y = (s16)Get16();
+            sample_buttons = Get8();
+            sample_mods = Get16();
+            break;
+
+        case REC_NONE:
+            break;
+
+        case REC_QUIT:
+            event->type = SDL_QUIT;
+            break;
+
+        case REC_KEY_DOWN:
+        case REC_KEY_UP:
+            event->type = tag == REC_KEY_DOWN ? SDL_KEYDOWN : SDL_KEYUP;
+            event->key.state = tag == REC_KEY_DOWN ? SDL_PRESSED : SDL_RELEASED;
+            event->key.keysym.sym = (SDL_Keycode)Get32();
+            event->key.keysym.scancode = Get16();
+            event->key.keysym.mod = Get16();
+            event->key.repeat = Get8();
+            break;
+
+        case REC_BUTTON_DOWN:
+        case REC_BUTTON_UP:
+            event->type = tag == REC_BUTTON_DOWN
+                ? SDL_MOUSEBUTTONDOWN
+                : SDL_MOUSEBUTTONUP;
+            event->button.state = tag == REC_BUTTON_DOWN
+                ? SDL_PRESSED
+                : SDL_RELEASED;
+            event->button.button = Get8();
+            event->button.clicks = Get8();
+            event->button.x = (s16)Get16();
+            event->button.y = (s16)Get16();
+            break;
+
+        case REC_MOTION:
+            event->type = SDL_MOUSEMOTION;
+            event->motion.state = Get8();
+            event->motion.x = (s16)Get16();
+            event->motion.y = (s16)Get16();
+            event->motion.xrel = (s16)Get16();
+            event->motion.yrel = (s16)Get16();
+            break;
+
+        case REC_WHEEL:
+            event->type = SDL_MOUSEWHEEL;
+            event->wheel.x = (s16)Get16();
+            event->wheel.y = (s16)Get16();
+            break;
+
+        case REC_TEXT: {
+            event->type = SDL_TEXTINPUT;
+            size_t len = Get8();
+            if ( len >= sizeof(event->text.text) ) {
+                printf("Bad text record in '%s'\n", input_path);
+                return EOF;
+            }
+            if ( fread(event->text.text, 1, len, input_file) != len ) {
+                return EOF;
+            }
+            break;
+        }
+
+        case REC_WINDOW:
+            event->type = SDL_WINDOWEVENT;
+            event->window.event = Get8();
+            event->window.data1 = (s32)Get32();
+            event->window.data2 = (s32)Get32();
+            break;
+
+        case REC_OTHER:
+            event->type = Get32();
+            break;
+
+        default:
+            printf("Bad record '%c' in '%s'\n", tag, input_path);
+            return EOF;
+    }
+
+    return feof(input_file) ? EOF : tag;
+}
+
+bool StartReplay(const char * path)
+{
+    input_file = fopen(path, "rb");
+    if ( input_file == NULL ) {
+        printf("Failed to open '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+
+    char magic[4];
+    if ( fread(magic, 1, 4, input_file) != 4
+        || memcmp(magic, INPUT_MAGIC, 4) != 0
+        || Get8() != INPUT_VERSION )
+    {
+        printf("'%s' is not an input recording\n", path);
+        fclose(input_file);
+        input_file = NULL;
+        return false;
+    }
+
+    int w = Get16();
+    int h = Get16();
+    u32 hash = Get32();
+    if ( w != app_w || h != app_h || hash != HashWorkArea() ) {
+        printf("Warning: '%s' was recorded with a different work area (%d x %d)\n",
+               path, w, h);
+    }
+
+    input_path = path;
+    input_mode = INPUT_REPLAY;
+    replay_start = SDL_GetPerformanceCounter();
+    return true;
+}
+
+bool NextEvent(SDL_Event * event, int timeout)
+{
+    if ( input_mode == INPUT_REPLAY ) {
+        int tag = ReadRecord(event);
+        while ( tag == REC_SAMPLE ) { // Left over from a frame that ended early
+            tag = ReadRecord(event);
+        }
+
+        if ( tag == EOF || tag == REC_NONE ) {
+            return false;
+        }
+
+        num_events++;
+        return true;
+    }
+
+    bool have_event;
+    if ( timeout < 0 ) {
+        have_event = SDL_WaitEvent(event);
+    } else if ( timeout == 0 ) {
+        have_event = SDL_PollEvent(event);
+    } else {
+        have_event = SDL_WaitEventTimeout(event, timeout);
+    }
+
+    if ( input_mode == INPUT_RECORD ) {
+        if ( have_event ) {
+            WriteEvent(event);
+        } else {
+            Put8(REC_NONE);
+        }
+    }
+
+    return have_event;
+}
+
+static void AddFrameTime(float ms)
+{
+    if ( num_frames == frames_allocated ) {
+        frames_allocated = frames_allocated ? frames_allocated * 2 : 1024;
+        frame_ms = realloc(frame_ms, frames_allocated * sizeof(*frame_ms));
+        if ( frame_ms == NULL ) {
+            printf("%s: out of memory\n", __func__);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    frame_ms[num_frames++] = ms;
+}
+
+bool SampleInput(void)
+{
+    if ( input_mode == INPUT_REPLAY ) {
+        u64 now = SDL_GetPerformanceCounter();
+        if ( last_sample != 0 ) {
+            AddFrameTime((now - last_sample) * 1000.0 / SDL_GetPerformanceFrequency());
+        }
+        last_sample = now;
+
+        SDL_Event event;
+        int tag = ReadRecord(&event);
+        while ( tag != REC_SAMPLE && tag != EOF ) { // Skip unread events
+            tag = ReadRecord(&event);
+        }
+
+        replay_ended = tag == EOF;
+        return !replay_ended;
+    }
+
+    sample_ticks = SDL_GetTicks();
+    sample_buttons = SDL_GetMouseState(&sample_x, &sample_y);
+    sample_mods = SDL_GetModState();
+
+    if ( input_mode == INPUT_RECORD ) {
+        Put8(REC_SAMPLE);
+        Put32(sample_ticks);
+        Put16((u16)sample_x);
+        Put16((u16)sample_y);
+        Put8((u8)sample_buttons);
+        Put16(sample_mods);
+    }
+
+    return true;
+}
+
+u32 InputMouse(int * x, int * y)
+{
+    if ( x ) *x = sample_x;
+    if ( y ) *y = sample_y;
+    return sample_buttons;
+}
+
+SDL_Keymod InputMods(void)
+{
+    return sample_mods;
+}
+
+u32 InputTicks(void)
+{
+    return sample_ticks;
+}
+
+static int CompareFloats(const void * a, const void * b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static float Percentile(int percent)
+{
+    int rank = (num_frames * percent + 99) / 100;
+    return frame_ms[MAX(rank, 1) - 1];
+}
+
+void StopInput(void)
+{
+    if ( input_mode == INPUT_RECORD ) {
+        if ( fclose(input_file) != 0 ) {
+            printf("Failed to write '%s'\n", input_path);
+        }
+    } else if ( input_mode == INPUT_REPLAY ) {
+        fclose(input_file);
+
+        u64 now = SDL_GetPerformanceCounter();
+        if ( !replay_ended && last_sample != 0 ) { // The frame that quit
+            AddFrameTime((now - last_sample) * 1000.0 / SDL_GetPerformanceFrequency());
+        }
+        double total = (now - replay_start) * 1000.0 / SDL_GetPerformanceFrequency();
+        printf("Replayed %d frames, %d events in %.1f ms\n",
+               num_frames,
+               num_events,
+               total);
+
+        if ( num_frames > 0 ) {
+            qsort(frame_ms, num_frames, sizeof(*frame_ms), CompareFloats);
+            printf("Frame ms: p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+                   Percentile(50),
+                   Percentile(95),
+                   Percentile(99),
+                   frame_ms[num_frames - 1]);
+        }
+
+        free(frame_ms);
+        frame_ms = NULL;
+        num_frames = frames_allocated = 0;
+        num_events = 0;
+        last_sample = 0;
+        replay_ended = false;
+    }
+
+    input_file = NULL;
+    input_mode = INPUT_LIVE;
+}
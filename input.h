@@ -0,0 +1,56 @@
+//
+//  input.h
+//  TextAppMaker
+//
+//  The input the main loop sees: events, and once per frame the mouse, the
+//  modifier keys and the time. Live from SDL, optionally recorded to a file,
+//  or replayed from one as fast as the loop can run.
+//
+//  A recording starts with the 4 byte magic "TAMI", u8 version (1), u16 width
+//  and u16 height of the work area, and a u32 FNV-1a hash of its cells. Then
+//  one record per call, in call order: a tag byte and its fields, little
+//  endian. 'S' is a frame sample (u32 ticks, s16 mouse x and y, u8 buttons,
+//  u16 modifiers), 'N' is no event, and the rest are events.
+//
+
+#ifndef input_h
+#define input_h
+
+#include "common.h"
+#include <stdbool.h>
+
+enum {
+    INPUT_LIVE,
+    INPUT_RECORD,
+    INPUT_REPLAY,
+};
+
+extern int input_mode;
+
+/// Record input to `path` from now on. Call with the work area loaded, as
+/// replays need to start from the same screen. Prints why and returns false on
+/// failure.
+bool StartRecording(const char * path);
+
+/// Take input from the recording at `path` instead of SDL. Warns if the work
+/// area is not the one it was recorded with. Prints why and returns false on
+/// failure.
+bool StartReplay(const char * path);
+
+/// Finish the recording, or print how long the replay's frames took.
+void StopInput(void);
+
+/// Wait up to `timeout` ms, or forever if -1, for an event. Replays return the
+/// next recorded one at once.
+bool NextEvent(SDL_Event * event, int timeout);
+
+/// Take the frame's sample of the mouse, modifiers and time. Returns false
+/// when a replay has run out.
+bool SampleInput(void);
+
+/// The frame's sample. Returns the mouse buttons.
+u32 InputMouse(int * x, int * y);
+SDL_Keymod InputMods(void);
+u32 InputTicks(void);
+
+#endif /* input_h */
@@ -6,37 +6,42 @@
 //
 
 #include "text.h"
+#include "grid.h"
+#include "render.h"
+#include "map.h"
+#include "fill.h"
+#include "ui.h"
+#include "file.h"
+#include "undo.h"
+#include "block.h"
+#include "replace.h"
+#include "export.h"
+#include "image.h"
+#include "import.h"
+#include "profile.h"
+#include "input.h"
+#include "stroke.h"
+#include "worker.h"
 #include "common.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 
-#define FONT_W 8
-#define FONT_H 16
-#define MAX(a, b) ((a > b) ? (a) : (b))
-#define MIN(a, b) ((a < b) ? (a) : (b))
-#define CLAMP(a, min, max) (a = a < min ? min : a > max ? max : a)
-
-#define GET_FG(x) ((x & 0x0F00) >> 8)
-#define GET_BG(x) ((x & 0xF000) >> 12)
-#define GET_CHAR(x) (x & 0xFF)
-#define SET_FG(x, fg) do { x &= 0xF0FF; x |= fg << 8; } while ( 0 );
-#define SET_BG(x, bg) do { x &= 0x0FFF; x |= bg << 12; } while ( 0 );
-#define SET_CHAR(x, ch) do { x &= 0xFF00; x |= ch; } while ( 0 );
 
 #define CHAR_PAL (py * 16 + px)
 
 #define SCALE 2.0f
-#define WINDOW_W ((app_w + 16) * FONT_W)
-#define WINDOW_H (MAX(16 * FONT_H, app_h * FONT_H))
+#define CURSOR_BLINK_MS 300
+#define TEXT_UNDO_PAUSE_MS 1000
+#define WORKING_POLL_MS 16 // For UI events while the worker has the map
+#define WINDOW_W ((view_w + 16) * FONT_W)
+#define WINDOW_H (MAX(16 * FONT_H, view_h * FONT_H))
 
 const char * file_name;
-SDL_Window * window;
-SDL_Renderer * renderer;
-SDL_Texture * texture;
-u8 app_w = 80;
-u8 app_h = 25;
+bool vsync; // Pace painting with the display instead of sleeping.
+bool show_profile;
 
 // Current foreground and background color
 u8 bg = 0;
@@ -58,41 +63,59 @@ enum {
 
 int last_mode;
 
-const SDL_Color palette[16] = {
-    { 0x00, 0x00, 0x00 },
-    { 0x00, 0x00, 0xAA },
-//    { 0x04, 0x14, 0x41 }, // Get that funkly blue color!
-    { 0x00, 0xAA, 0x00 },
-    { 0x00, 0xAA, 0xAA },
-    { 0xAA, 0x00, 0x00 },
-    { 0xAA, 0x00, 0xAA },
-    { 0xAA, 0x55, 0x00 },
-    { 0xAA, 0xAA, 0xAA },
-    { 0x55, 0x55, 0x55 },
-    { 0x55, 0x55, 0xFF },
-    { 0x55, 0xFF, 0x55 },
-    { 0x55, 0xFF, 0xFF },
-    { 0xFF, 0x55, 0x55 },
-    { 0xFF, 0x55, 0xFF },
-    { 0xFF, 0xFF, 0x55 },
-    { 0xFF, 0xFF, 0xFF },
-};
-
 const SDL_Color orange = { 0xFF, 0xA5, 0x00, 0xFF };
 
-#define MAX_WIDTH 256
-#define MAX_HEIGHT 256
+block_t clipboard;
 
-u16 map[MAX_HEIGHT][MAX_WIDTH];
-u16 copy[MAX_HEIGHT][MAX_WIDTH];
+bool task_queued; // This frame. No more events are handled until it's done.
 
 bool dragging;
 bool got_box;
 int left, right, top, bottom; // location of selection box in map
-int copy_left, copy_right, copy_top, copy_bottom; // location of data in copy
 SDL_Point drag_start;
 SDL_Point drag_end;
 
+SDL_Rect SelectionRect(void)
+{
+    return (SDL_Rect){ left, top, right - left + 1, bottom - top + 1 };
+}
+
+// Hand an edit to the worker, after the stroke painted so far.
+void QueueTask(task_t task)
+{
+    PaintStroke(CHAR_PAL, fg, bg);
+    PushTask(&task);
+    task_queued = true;
+}
+
+// Move the selected cells and the selection box with them. The worker moves
+// the cells; the box moves now, clipped to the work area as MoveBlock clips
+// it.
+void MoveSelection(int dx, int dy)
+{
+    QueueTask((task_t){
+        .kind = TASK_MOVE,
+        .move = { SelectionRect(), dx, dy }
+    });
+
+    SDL_Rect area = { 0, 0, app_w, app_h };
+    SDL_Rect r = SelectionRect();
+    if ( SDL_IntersectRect(&r, &area, &r) ) {
+        r.x += dx;
+        r.y += dy;
+        SDL_IntersectRect(&r, &area, &r);
+    }
+
+    if ( r.w > 0 ) {
+        left = r.x;
+        top = r.y;
+        right = r.x + r.w - 1;
+        bottom = r.y + r.h - 1;
+    } else {
+        got_box = false;
+    }
+}
+
 void SetRenderColor(SDL_Color color)
 {
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
@@ -104,11 +127,24 @@ void SetPaletteColor(int index)
     SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, 255);
 }
 
-void RenderBackground(int x, int y, int index)
+// Where typing would continue the last text undo step, and when that was. A
+// jump of the cursor, a change of mode or a pause starts a new step.
+SDL_Point text_next = { -1, -1 };
+u32 text_ticks;
+
+void BeginTextEdit(void)
+{
+    bool coalesce = cx == text_next.x
+        && cy == text_next.y
+        && InputTicks() - text_ticks < TEXT_UNDO_PAUSE_MS;
+    BeginEdit(EDIT_TEXT, coalesce);
+}
+
+void EndTextEdit(void)
 {
-    SetPaletteColor(index);
-    SDL_Rect r = { x, y, FONT_W, FONT_H };
-    SDL_RenderFillRect(renderer, &r);
+    EndEdit();
+    text_next = (SDL_Point){ cx, cy };
+    text_ticks = InputTicks();
 }
 
 void AdvanceCursor(void)
@@ -122,138 +158,147 @@ void AdvanceCursor(void)
     }
 }
 
+// The map cell under window pixel x, y, which may be outside the window.
+SDL_Point MapCellAt(int x, int y)
+{
+    int w = FONT_W * SCALE;
+    int h = FONT_H * SCALE;
+    x = x >= 0 ? x / w : (x + 1) / w - 1;
+    y = y >= 0 ? y / h : (y + 1) / h - 1;
+    return (SDL_Point){ x + view_x, y + view_y };
+}
+
 // Update SDL_Window with new app_w and app_h
 void ResizeWindow(void)
 {
-    SDL_SetWindowSize(window, WINDOW_W * SCALE, WINDOW_H * SCALE);
-    SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
-    SDL_RenderSetLogicalSize(renderer, WINDOW_W, WINDOW_H);
+    CLAMP(app_w, 1, MAX_WIDTH);
+    CLAMP(app_h, 1, MAX_HEIGHT);
+    SetView(view_x, view_y);
+
+    // Once the work area is bigger than the view, only the title changes.
+    int w, h;
+    SDL_RenderGetLogicalSize(renderer, &w, &h);
+    if ( w != WINDOW_W || h != WINDOW_H ) {
+        SDL_SetWindowSize(window, WINDOW_W * SCALE, WINDOW_H * SCALE);
+        SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+        SDL_RenderSetLogicalSize(renderer, WINDOW_W, WINDOW_H);
+    }
 
     char buf[100] = { 0 };
     snprintf(buf, 100, "%s: %d x %d", file_name, app_w, app_h);
     SDL_SetWindowTitle(window, buf);
 
-    if ( texture ) {
-        SDL_DestroyTexture(texture);
-    }
-
-    texture = SDL_CreateTexture(renderer,
-                                SDL_PIXELFORMAT_RGBA8888,
-                                SDL_TEXTUREACCESS_TARGET,
-                                app_w * FONT_W,
-                                app_h * FONT_H);
-
-    SDL_SetRenderTarget(renderer, texture);
-
-    for ( int y = 0; y < app_h; y++ ) {
-        for ( int x = 0; x < app_w; x++ ) {
-            int rx = x * FONT_W;
-            int ry = y * FONT_H;
-
-            RenderBackground(rx, ry, GET_BG(map[y][x]));
-            SetPaletteColor(GET_FG(map[y][x]));
-            PrintChar(rx, ry, GET_CHAR(map[y][x]));
-        }
-    }
-
-    SDL_SetRenderTarget(renderer, NULL);
-}
-
-/// Draw texture cell x, y from data in map[y][x]
-void RefreshTexture(int x, int y)
-{
-    int rx = x * FONT_W; // Render position.
-    int ry = y * FONT_H;
-
-    SDL_SetRenderTarget(renderer, texture);
-
-    s16 cell = map[y][x];
-
-    RenderBackground(rx, ry, GET_BG(cell));
-    SetPaletteColor(GET_FG(cell));
-    PrintChar(rx, ry, GET_CHAR(cell));
-
-    SDL_SetRenderTarget(renderer, NULL);
-}
-
-void UpdateMapPosition(int x, int y, u8 ch, u8 _fg, u8 _bg)
-{
-    SET_CHAR(map[y][x], ch);
-    SET_FG(map[y][x], _fg);
-    SET_BG(map[y][x], _bg);
-
-    RefreshTexture(x, y);
+    ResizeMapTexture();
 }
 
-void SaveFile(void)
+// Whether the worker can be left with the map while `event` is handled: it
+// only touches the window, the mode, the colors or the selection box. Recording
+// takes just quit and window events this way, so replays stay in step.
+bool IsUIEvent(const SDL_Event * event)
 {
-    FILE * file = fopen(file_name, "wb");
-    if ( file == NULL ) {
-        printf("Failed to create '%s'!\n", file_name);
-        return;
-    }
-
-    fwrite(&app_w, sizeof(app_w), 1, file);
-    fwrite(&app_h, sizeof(app_h), 1, file);
-
-    for ( int y = 0; y < app_h; y++ ) {
-        for ( int x = 0; x < app_w; x++ ) {
-            fwrite(&map[y][x], sizeof(map[0][0]), 1, file);
-        }
+    if ( event->type == SDL_QUIT || event->type == SDL_WINDOWEVENT ) {
+        return true;
     }
-
-    fclose(file);
-    printf("Saved '%s'\n", file_name);
-}
-
-void LoadFile(void)
-{
-    FILE * file = fopen(file_name, "rb");
-    if ( file == NULL ) {
-        printf("'%s' does not exist, it will be created.\n", file_name);
-        return;
+    if ( input_mode != INPUT_LIVE ) {
+        return false;
     }
 
-    fread(&app_w, sizeof(app_w), 1, file);
-    fread(&app_h, sizeof(app_h), 1, file);
+    SDL_Keymod mods = SDL_GetModState();
+    switch ( event->type ) {
+        case SDL_KEYUP:
+        case SDL_MOUSEMOTION: // Painted once the map is back.
+            return true;
+
+        case SDL_KEYDOWN:
+            switch ( event->key.keysym.sym ) {
+                case SDLK_TAB:
+                case SDLK_ESCAPE:
+                case SDLK_EQUALS:
+                case SDLK_MINUS:
+                    return true;
+                case SDLK_F3:
+                    return !(mods & KMOD_SHIFT);
+                case SDLK_UP:
+                case SDLK_DOWN:
+                case SDLK_LEFT:
+                case SDLK_RIGHT:
+                    // Palette cursor, not a move of the selection.
+                    return mods & KMOD_SHIFT && !(got_box && mods & KMOD_GUI);
+                default:
+                    return false;
+            }
 
-    for ( int y = 0; y < app_h; y++ ) {
-        for ( int x = 0; x < app_w; x++ ) {
-            fread(&map[y][x], sizeof(map[0][0]), 1, file);
-        }
+        default:
+            return false;
     }
-
-    fclose(file);
 }
 
-void FloodFill(int x, int y, u16 replace, u16 new)
+// While the worker has the map: take the next event if it's a UI event. The
+// first one that isn't stays queued, with everything after it, to be handled
+// in order once the worker is done.
+bool NextUIEvent(SDL_Event * event)
 {
-    if ( x < 0 || y < 0 || x > app_w - 1 || y > app_h - 1 ) {
-        return;
-    }
-
-    if ( map[y][x] != replace ) {
-        return;
+    SDL_PumpEvents();
+    if ( SDL_PeepEvents(event, 1, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) < 1
+        || !IsUIEvent(event) )
+    {
+        return false;
     }
 
-    UpdateMapPosition(x, y, GET_CHAR(new), GET_FG(new), GET_BG(new));
-
-    FloodFill(x + 1, y, replace, new);
-    FloodFill(x - 1, y, replace, new);
-    FloodFill(x, y + 1, replace, new);
-    FloodFill(x, y - 1, replace, new);
+    return SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) == 1;
 }
 
 int main(int argc, char ** argv)
 {
-    if ( argc != 2 ) {
+    const char * import_name = NULL;
+    const char * record_name = NULL;
+    const char * replay_name = NULL;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strncmp(argv[i], "--backend=", 10) == 0 ) {
+            int b = BackendFromName(argv[i] + 10);
+            if ( b == -1 ) {
+                printf("Error: unknown backend '%s'\n", argv[i] + 10);
+                return -1;
+            }
+            backend = b;
+        } else if ( strcmp(argv[i], "--vsync") == 0 ) {
+            vsync = true;
+        } else if ( strncmp(argv[i], "--import=", 9) == 0 ) {
+            import_name = argv[i] + 9;
+        } else if ( strncmp(argv[i], "--record=", 9) == 0 ) {
+            record_name = argv[i] + 9;
+        } else if ( strncmp(argv[i], "--replay=", 9) == 0 ) {
+            replay_name = argv[i] + 9;
+        } else {
+            file_name = argv[i];
+        }
+    }
+
+    if ( file_name == NULL ) {
         printf("Error: no file specified\n");
-        printf("usage: %s [filename]\n", argv[0]);
+        printf("usage: %s [--backend=geometry|software|points] [--vsync] [--import=file.ans] [--record=file | --replay=file] [filename]\n", argv[0]);
         return -1;
     }
 
-    file_name = argv[1];
-    LoadFile();
+    // An imported file is edited and saved as `file_name`.
+    if ( import_name ) {
+        sauce_t sauce;
+        if ( !ImportANSI(import_name, &sauce) ) {
+            return -1;
+        }
+        if ( sauce.title[0] ) {
+            printf("Imported '%s' by %s\n", sauce.title, sauce.author[0] ? sauce.author : "unknown");
+        }
+    } else {
+        LoadFile(file_name);
+    }
+
+    // Replays run as fast as they can, without a window.
+    if ( replay_name ) {
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+        vsync = false;
+    }
 
     SDL_Init(SDL_INIT_VIDEO);
     window = SDL_CreateWindow("",
@@ -261,25 +306,90 @@ int main(int argc, char ** argv)
                               SDL_WINDOWPOS_CENTERED,
                               640,
                               480,
-                              0);
-    renderer = SDL_CreateRenderer(window, -1, 0);
+                              replay_name ? SDL_WINDOW_HIDDEN : 0);
+    renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    InitText();
+    SetBackend(backend);
     ResizeWindow();
 
+    if ( record_name && !StartRecording(record_name) ) {
+        return -1;
+    }
+    if ( replay_name && !StartReplay(replay_name) ) {
+        return -1;
+    }
+    if ( !StartWorker() ) {
+        return -1;
+    }
+
 //    SDL_ShowCursor(SDL_DISABLE);
     SDL_StartTextInput();
 
     bool run = true;
+    bool redraw = true;
+    u32 blink_deadline = 0; // Next time the blinking cursor changes.
+
     while ( run ) {
-        SDL_Keymod mods = SDL_GetModState();
+        // Sleep until there is input or something to redraw. While painting
+        // in vsync mode, run every frame and let the present pace the loop.
+        // While the worker has the map, handle only UI events, leaving the
+        // rest queued, and keep the window drawing.
+
+        bool working = WorkerBusy();
+        task_queued = false;
+
+        // A replay's hidden window still renders every frame.
+        bool visible = input_mode == INPUT_REPLAY
+            || !(SDL_GetWindowFlags(window)
+                 & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED));
+        bool painting = vsync
+            && mode == MODE_PAINT
+            && InputMouse(NULL, NULL) & SDL_BUTTON(SDL_BUTTON_LEFT);
+
+        SDL_Event event;
+        bool have_event = false;
+        if ( working ) {
+            WaitForWorker(WORKING_POLL_MS);
+            have_event = NextUIEvent(&event);
+            redraw = true;
+        } else if ( painting ) {
+            have_event = NextEvent(&event, 0);
+            redraw = true;
+        } else if ( !visible ) {
+            have_event = NextEvent(&event, -1);
+        } else if ( redraw || dirty_cells > 0 ) {
+            have_event = NextEvent(&event, 0);
+        } else {
+            int timeout = (int)(blink_deadline - SDL_GetTicks());
+            have_event = NextEvent(&event, MAX(timeout, 0));
+        }
+
+        if ( !working && !SampleInput() ) {
+            break; // End of the replay
+        }
 
+        BeginPhase(PHASE_EVENTS);
+        // A working frame's sample is stale, and live keys are its only input.
+        SDL_Keymod mods = working && input_mode == INPUT_LIVE
+            ? SDL_GetModState()
+            : InputMods();
+
+        // Mouse position in window cells, and the map cell under it.
         int mx, my;
-        u32 buttons = SDL_GetMouseState(&mx, &my);
+        u32 buttons = InputMouse(&mx, &my);
         mx /= FONT_W * SCALE;
         my /= FONT_H * SCALE;
+        bool over_map = mx >= 0 && mx < view_w && my >= 0 && my < view_h;
+        int map_x = mx + view_x;
+        int map_y = my + view_y;
+
+        for ( bool more = have_event;
+              more;
+              more = working ? NextUIEvent(&event) : !task_queued && NextEvent(&event, 0) )
+        {
+            redraw = true;
 
-        SDL_Event event;
-        while ( SDL_PollEvent(&event) ) {
             switch ( event.type ) {
 
                 case SDL_QUIT:
@@ -295,17 +405,7 @@ int main(int argc, char ** argv)
                                 (mods & KMOD_GUI)
                                 && got_box )
                             {
-                                for ( int y = top; y <= bottom; y++ ) {
-                                    for ( int x = left; x <= right; x++ ) {
-                                        copy[y][x] = map[y][x];
-                                    }
-                                }
-
-                                copy_left = left;
-                                copy_right = right;
-                                copy_top = top;
-                                copy_bottom = bottom;
-
+                                CopyBlock(&clipboard, SelectionRect());
                                 got_box = false;
                             }
                             break;
@@ -316,40 +416,157 @@ int main(int argc, char ** argv)
                                 (mods & KMOD_GUI)
                                 && !got_box )
                             {
-                                for ( int y = copy_top; y <= copy_bottom; y++ ) {
-                                    for ( int x = copy_left; x <= copy_right; x++ ) {
-                                        int map_x = mx + (x - copy_left);
-                                        int map_y = my + (y - copy_top);
-                                        map[map_y][map_x] = copy[y][x];
-                                        RefreshTexture(map_x, map_y);
-                                    }
+                                if ( over_map ) {
+                                    QueueTask((task_t){
+                                        .kind = TASK_PASTE,
+                                        .paste = { &clipboard, map_x, map_y }
+                                    });
+                                }
+                            }
+                            break;
+
+                        case SDLK_z:
+                            if ( mods & KMOD_GUI ) {
+                                QueueTask((task_t){
+                                    .kind = mods & KMOD_SHIFT ? TASK_REDO : TASK_UNDO
+                                });
+                            }
+                            break;
+
+                        case SDLK_g:
+                            // Replace cells like the one under the mouse with
+                            // the brush, in the selection or the whole map.
+                            // Not Cmd+H, which macOS keeps for Hide.
+                            // Alt: glyph, Ctrl: foreground, Shift: background,
+                            // none: the whole cell.
+                            if ( mods & KMOD_GUI && over_map ) {
+                                u16 mask = 0;
+                                if ( mods & KMOD_ALT ) mask |= CELL_CHAR;
+                                if ( mods & KMOD_CTRL ) mask |= CELL_FG;
+                                if ( mods & KMOD_SHIFT ) mask |= CELL_BG;
+                                if ( mask == 0 ) mask = CELL_ALL;
+
+                                u16 brush = 0;
+                                SET_CHAR(brush, CHAR_PAL);
+                                SET_FG(brush, fg);
+                                SET_BG(brush, bg);
+
+                                SDL_Rect area = { 0, 0, app_w, app_h };
+                                if ( got_box ) {
+                                    area = SelectionRect();
                                 }
+
+                                QueueTask((task_t){
+                                    .kind = TASK_REPLACE,
+                                    .replace = {
+                                        area, GetCell(map_x, map_y), mask, brush
+                                    }
+                                });
+                            }
+                            break;
+
+                        case SDLK_r:
+                            // Recolor the selection, Shift: foreground only,
+                            // Alt: background only.
+                            if ( mods & KMOD_GUI && got_box ) {
+                                QueueTask((task_t){
+                                    .kind = TASK_RECOLOR,
+                                    .recolor = {
+                                        SelectionRect(),
+                                        mods & KMOD_ALT ? -1 : fg,
+                                        mods & KMOD_SHIFT ? -1 : bg
+                                    }
+                                });
                             }
                             break;
 
                         case SDLK_TAB:
                             mode = (mode + 1) % NUM_MODES;
+                            text_next = (SDL_Point){ -1, -1 };
                             got_box = false; // Cancel selection box.
                             break;
 
                         case SDLK_s:
+                            // Replays leave the file as they found it.
+                            if ( (mods & KMOD_GUI) && input_mode != INPUT_REPLAY ) {
+                                task_t save = { .kind = TASK_SAVE };
+                                snprintf(save.file.path, sizeof(save.file.path), "%s", file_name);
+                                QueueTask(save);
+                            }
+                            break;
+
+                        case SDLK_e:
+                            // Export next to the screen file, Shift: as text,
+                            // Alt: as a PNG image.
                             if ( mods & KMOD_GUI ) {
-                                SaveFile();
+                                task_t export = { .kind = TASK_EXPORT };
+                                const char * extension = "ans";
+                                if ( mods & KMOD_ALT ) {
+                                    export.kind = TASK_IMAGE;
+                                    export.file.format = IMAGE_PNG;
+                                    extension = "png";
+                                } else if ( mods & KMOD_SHIFT ) {
+                                    export.file.format = EXPORT_TEXT;
+                                    extension = "txt";
+                                } else {
+                                    export.file.format = EXPORT_ANSI;
+                                }
+                                snprintf(export.file.path,
+                                         sizeof(export.file.path),
+                                         "%s.%s",
+                                         file_name,
+                                         extension);
+                                QueueTask(export);
+                            }
+                            break;
+
+                        case SDLK_F3:
+                            // Frame profile, Shift: dump it next to the file.
+                            if ( mods & KMOD_SHIFT ) {
+                                char profile_path[1024];
+                                snprintf(profile_path,
+                                         sizeof(profile_path),
+                                         "%s.profile.csv",
+                                         file_name);
+                                DumpProfile(profile_path);
+                            } else {
+                                show_profile = !show_profile;
                             }
                             break;
 
+                        case SDLK_F2:
+                            SetBackend((backend + 1) % NUM_BACKENDS);
+                            ResizeWindow();
+                            printf("Using %s backend\n", BackendName(backend));
+                            break;
+
                         case SDLK_ESCAPE:
                             got_box = false;
                             break;
 
                         case SDLK_f:
+                            // Shift: 8-way, Alt: match glyph only,
+                            // Ctrl: match color only.
                             if ( mode == MODE_PAINT && mods & KMOD_GUI) {
                                 u16 new = 0;
                                 SET_CHAR(new, CHAR_PAL);
                                 SET_FG(new, fg);
                                 SET_BG(new, bg);
-                                if ( map[my][mx] != new ) {
-                                    FloodFill(mx, my, map[my][mx], new);
+
+                                int match = FILL_MATCH_CELL;
+                                if ( mods & KMOD_ALT ) {
+                                    match = FILL_MATCH_GLYPH;
+                                } else if ( mods & KMOD_CTRL ) {
+                                    match = FILL_MATCH_COLOR;
+                                }
+
+                                if ( over_map ) {
+                                    QueueTask((task_t){
+                                        .kind = TASK_FILL,
+                                        .fill = {
+                                            map_x, map_y, new, match, mods & KMOD_SHIFT
+                                        }
+                                    });
                                 }
                             }
                             break;
@@ -381,7 +598,9 @@ int main(int argc, char ** argv)
                             break;
 
                         case SDLK_UP:
-                            if ( mods & KMOD_SHIFT ) {
+                            if ( got_box && mods & KMOD_GUI ) {
+                                MoveSelection(0, -1);
+                            } else if ( mods & KMOD_SHIFT ) {
                                 py--;
                                 if ( py < 0 ) py = 15;
                             } else if ( mods & KMOD_ALT ) {
@@ -392,11 +611,14 @@ int main(int argc, char ** argv)
                                 if ( cy < 0 ) {
                                     cy = app_h - 1;
                                 }
+                                ScrollToCell(cx, cy);
                             }
                             break;
 
                         case SDLK_DOWN:
-                            if ( mods & KMOD_SHIFT ) {
+                            if ( got_box && mods & KMOD_GUI ) {
+                                MoveSelection(0, 1);
+                            } else if ( mods & KMOD_SHIFT ) {
                                 py = (py + 1) % 16;
                             } else if ( mods & KMOD_ALT ) {
                                 app_h--;
@@ -406,11 +628,14 @@ int main(int argc, char ** argv)
                                 if ( cy >= app_h ) {
                                     cy = 0;
                                 }
+                                ScrollToCell(cx, cy);
                             }
                             break;
 
                         case SDLK_LEFT:
-                            if ( mods & KMOD_SHIFT ) {
+                            if ( got_box && mods & KMOD_GUI ) {
+                                MoveSelection(-1, 0);
+                            } else if ( mods & KMOD_SHIFT ) {
                                 px--;
                                 if ( px < 0 ) px = 15;
                             } else if ( mods & KMOD_ALT ) {
@@ -421,11 +646,14 @@ int main(int argc, char ** argv)
                                 if ( cx < 0 ) {
                                     cx = app_w - 1;
                                 }
+                                ScrollToCell(cx, cy);
                             }
                             break;
 
                         case SDLK_RIGHT:
-                            if ( mods & KMOD_SHIFT ) {
+                            if ( got_box && mods & KMOD_GUI ) {
+                                MoveSelection(1, 0);
+                            } else if ( mods & KMOD_SHIFT ) {
                                 px = (px + 1) % 16;
                             } else if ( mods & KMOD_ALT ) {
                                 app_w++;
@@ -435,6 +663,23 @@ int main(int argc, char ** argv)
                                 if ( cx >= app_w ) {
                                     cx = 0;
                                 }
+                                ScrollToCell(cx, cy);
+                            }
+                            break;
+
+                        case SDLK_PAGEUP:
+                            if ( mods & KMOD_SHIFT ) {
+                                SetView(view_x - view_w, view_y);
+                            } else {
+                                SetView(view_x, view_y - view_h);
+                            }
+                            break;
+
+                        case SDLK_PAGEDOWN:
+                            if ( mods & KMOD_SHIFT ) {
+                                SetView(view_x + view_w, view_y);
+                            } else {
+                                SetView(view_x, view_y + view_h);
                             }
                             break;
 
@@ -446,13 +691,21 @@ int main(int argc, char ** argv)
                                 else
                                     bg_set = bg;
 
-                                for ( int y = top; y <= bottom; y++ ) {
-                                    for ( int x = left; x <= right; x++ ) {
-                                        UpdateMapPosition(x, y, 0, fg, bg_set);
-                                    }
-                                }
+                                u16 blank = 0;
+                                SET_FG(blank, fg);
+                                SET_BG(blank, bg_set);
+
+                                QueueTask((task_t){
+                                    .kind = TASK_CLEAR,
+                                    .clear = { SelectionRect(), blank }
+                                });
                             } else {
-                                SET_CHAR(map[cy][cx], 0);
+                                u16 cell = GetCell(cx, cy);
+                                SET_CHAR(cell, 0);
+                                BeginTextEdit();
+                                SetCell(cx, cy, cell);
+                                EndTextEdit();
+                                MarkDirty(cx, cy);
                             }
                             break;
 
@@ -477,10 +730,14 @@ int main(int argc, char ** argv)
                     switch ( event.button.button ) {
 
                         case SDL_BUTTON_LEFT:
-
                             if ( mods & KMOD_SHIFT ) {
-                                dragging = true;
-                                drag_start = (SDL_Point){ mx, my };
+                                if ( over_map ) {
+                                    dragging = true;
+                                    drag_start = (SDL_Point){ map_x, map_y };
+                                }
+                            } else if ( mode == MODE_PAINT ) {
+                                SDL_Point cell = MapCellAt(event.button.x, event.button.y);
+                                BeginStroke(cell.x, cell.y);
                             }
                             break;
 
@@ -492,6 +749,7 @@ int main(int argc, char ** argv)
                     switch ( event.button.button ) {
 
                         case SDL_BUTTON_LEFT:
+                            EndStroke();
 //                            if ( mode == MODE_COPY ) {
                             if ( mods & KMOD_SHIFT ) {
                                 got_box = true;
@@ -504,11 +762,30 @@ int main(int argc, char ** argv)
                     }
                     break;
 
+                case SDL_MOUSEMOTION:
+                    // Every position, not just the frame's, so fast strokes
+                    // leave no gaps.
+                    if ( event.motion.state & SDL_BUTTON_LMASK
+                        && mode == MODE_PAINT
+                        && !(mods & KMOD_SHIFT) )
+                    {
+                        SDL_Point cell = MapCellAt(event.motion.x, event.motion.y);
+                        StrokeTo(cell.x, cell.y);
+                    }
+                    break;
+
+                case SDL_MOUSEWHEEL:
+                    SetView(view_x - event.wheel.x, view_y - event.wheel.y);
+                    break;
+
                 case SDL_TEXTINPUT:
                     if ( mode != MODE_TEXT  ) break;
                     if ( isprint(event.text.text[0]) ) {
+                        BeginTextEdit();
                         UpdateMapPosition(cx, cy, event.text.text[0], fg, bg);
                         AdvanceCursor();
+                        EndTextEdit();
+                        ScrollToCell(cx, cy);
                     }
                     break;
 
@@ -518,7 +795,10 @@ int main(int argc, char ** argv)
         }
 
         if ( dragging ) {
-            drag_end = (SDL_Point){ mx, my };
+            drag_end = (SDL_Point){
+                MAX(0, MIN(map_x, view_x + view_w - 1)),
+                MAX(0, MIN(map_y, view_y + view_h - 1))
+            };
             // Update selection box
             if ( drag_start.x < drag_end.x ) {
                 left = drag_start.x;
@@ -537,72 +817,91 @@ int main(int argc, char ** argv)
             }
         }
 
+        // Whether the map is still this thread's for the rest of the frame.
+        bool own_map = !working && !task_queued;
+
         // Handle left click
 
+        if ( own_map ) {
+            PaintStroke(CHAR_PAL, fg, bg);
+        }
+
         if ( buttons & SDL_BUTTON(SDL_BUTTON_LEFT) ) {
             if ( mode == MODE_PAINT && !(mods & KMOD_SHIFT) ) {
-                if ( mx >= 0 && mx < app_w && my >= 0 && my < app_h ) {
-                    UpdateMapPosition(mx, my, CHAR_PAL, fg, bg);
-                } else if ( mx >= app_w
-                           && mx < app_w + 16
-                           && my >= 0
-                           && my < 16 )
-                {
-
-                    px = mx - app_w;
+                if ( mx >= view_w && mx < view_w + 16 && my >= 0 && my < 16 ) {
+                    px = mx - view_w;
                     py = my;
                 }
-            } else if ( mode == MODE_TEXT ) {
-                cx = mx;
-                cy = my;
+            } else if ( mode == MODE_TEXT && over_map ) {
+                cx = map_x;
+                cy = map_y;
             }
         }
 
         // Pick up what's under cursor
 
-        if ( buttons & SDL_BUTTON(SDL_BUTTON_RIGHT)
+        if ( own_map
+            && buttons & SDL_BUTTON(SDL_BUTTON_RIGHT)
+            && over_map
             && (mode == MODE_PAINT || mode == MODE_TEXT) ) {
-            fg = GET_FG(map[my][mx]);
-            bg = GET_BG(map[my][mx]);
-            int ch = GET_CHAR(map[my][mx]);
+            u16 cell = GetCell(map_x, map_y);
+            fg = GET_FG(cell);
+            bg = GET_BG(cell);
+            int ch = GET_CHAR(cell);
             px = ch % 16;
             py = ch / 16;
         }
 
+        EndPhase(PHASE_EVENTS);
+
         //
         // Render
         //
 
-        SDL_SetRenderDrawColor(renderer, 16, 16, 16, 255);
-        SDL_RenderClear(renderer);
+        if ( !own_map
+            || SDL_TICKS_PASSED(InputTicks(), blink_deadline)
+            || dirty_cells > 0 )
+        {
+            redraw = true;
+        }
 
-        SDL_SetRenderDrawColor(renderer, 32, 32, 32, 255);
-        for ( int x = FONT_W; x < WINDOW_W + WINDOW_H; x += FONT_W ) {
-            SDL_RenderDrawLine(renderer, x, 0, 0, x * 2);
+        if ( !redraw || !visible ) {
+            continue;
         }
 
+        redraw = false;
+        blink_deadline = InputTicks() / CURSOR_BLINK_MS * CURSOR_BLINK_MS + CURSOR_BLINK_MS;
+
+        BeginPhase(PHASE_TEXTURE);
+        SDL_SetRenderDrawColor(renderer, 16, 16, 16, 255);
+        SDL_RenderClear(renderer);
+        RenderHatching(WINDOW_W, WINDOW_H);
+
         // Render `map` texture
 
-        SDL_Rect map_rect = { 0, 0, FONT_W * app_w, FONT_H * app_h };
-        SDL_RenderCopy(renderer, texture, NULL, &map_rect);
+        if ( own_map ) {
+            FlushDirty();
+        }
+        SDL_Rect map_rect = { 0, 0, FONT_W * view_w, FONT_H * view_h };
+        RenderMap(&map_rect);
+        EndPhase(PHASE_TEXTURE);
 
         // Render Character Palette
 
+        BeginPhase(PHASE_PALETTE);
         if ( mode == MODE_PAINT ) {
-            for ( int y = 0; y < 16; y++ ) {
-                for ( int x = 0; x < 16; x++ ) {
-                    int rx = (x + app_w) * FONT_W;
-                    int ry = y * FONT_H;
-                    RenderBackground(rx, ry, bg);
-                    SetPaletteColor(fg);
-                    PrintChar(rx, ry, y * 16 + x);
-                }
-            }
+            RenderCharPalette(view_w * FONT_W, 0, fg, bg);
+        }
+        EndPhase(PHASE_PALETTE);
+
+        // Render Selection
 
+        BeginPhase(PHASE_OVERLAY);
+        if ( mode == MODE_PAINT ) {
             if ( dragging || got_box ) {
                 SDL_Rect selection = {
-                    left * FONT_W,
-                    top * FONT_H,
+                    (left - view_x) * FONT_W,
+                    (top - view_y) * FONT_H,
                     ((right - left) + 1) * FONT_W,
                     ((bottom - top) + 1) * FONT_H,
                 };
@@ -616,21 +915,21 @@ int main(int argc, char ** argv)
 
         } else if ( mode == MODE_TEXT ) {
             SetPaletteColor(fg);
-            PrintString(app_w * FONT_W + 2, 2, "Text Entry Mode");
+            PrintString(view_w * FONT_W + 2, 2, "Text Entry Mode");
         }
 //        else if ( mode == MODE_COPY ) {
 //            SetPaletteColor(15);
-//            PrintString(app_w * FONT_W + 2, 2, "Copy Mode");
+//            PrintString(view_w * FONT_W + 2, 2, "Copy Mode");
 
 //        }
 
         // Render Cursors
 
-        if ( SDL_GetTicks() % 600 < 300 ) {
+        if ( InputTicks() % (CURSOR_BLINK_MS * 2) < CURSOR_BLINK_MS ) {
             if ( mode == MODE_TEXT ) {
-                PrintChar(cx * FONT_W, cy * FONT_H, 219);
+                PrintChar((cx - view_x) * FONT_W, (cy - view_y) * FONT_H, 219);
             } else if ( mode == MODE_PAINT ) {
-                PrintChar((app_w + px) * FONT_W, py * FONT_H, 219);
+                PrintChar((view_w + px) * FONT_W, py * FONT_H, 219);
             }
         }
 
@@ -640,7 +939,7 @@ int main(int argc, char ** argv)
         SDL_SetRenderDrawColor(renderer, 0xFF, 0xA5, 0x00, 0xff);
         SDL_RenderDrawRect(renderer, &mouse_rect);
         if ( mode == MODE_PAINT ) {
-            if ( mx >= 0 && my >= 0 && mx < app_w && my < app_h ) {
+            if ( over_map ) {
                 SetPaletteColor(fg);
                 PrintChar(mx * FONT_W, my * FONT_H, CHAR_PAL);
             }
@@ -649,19 +948,35 @@ int main(int argc, char ** argv)
         // Render Workarea / Character Palette dividers
 
         SDL_SetRenderDrawColor(renderer, 64, 64, 64, 255);
-        int divider_x = app_w * FONT_W - 1;
+        int divider_x = view_w * FONT_W - 1;
         SDL_RenderDrawLine(renderer, divider_x, 0, divider_x, WINDOW_H);
         int divider_y = FONT_H * 16;
-        SDL_RenderDrawLine(renderer, app_w * FONT_W, divider_y, WINDOW_W, divider_y);
+        SDL_RenderDrawLine(renderer, view_w * FONT_W, divider_y, WINDOW_W, divider_y);
 
         // Render Cursor Position
         SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        PrintString(app_w * FONT_W, 16 * FONT_H, "%d, %d", mx, my);
+        PrintString(view_w * FONT_W, 16 * FONT_H, "%d, %d", map_x, map_y);
+        if ( !own_map && SDL_GetTicks() % (CURSOR_BLINK_MS * 2) < CURSOR_BLINK_MS ) {
+            PrintString(view_w * FONT_W, 17 * FONT_H, "working...");
+        }
+        EndPhase(PHASE_OVERLAY);
+
+        if ( show_profile ) {
+            RenderProfile(0, 0);
+        }
 
+        BeginPhase(PHASE_PRESENT);
         SDL_RenderPresent(renderer);
-        SDL_Delay(15);
+        EndPhase(PHASE_PRESENT);
+        EndFrame();
     }
 
+    StopWorker();
+    StopInput();
+    FreeUI();
+    FreeMapTexture();
+    FreeGrid();
+    FreeText();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
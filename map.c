@@ -0,0 +1,337 @@
+//
+//  map.c
+//  TextAppMaker
+//
+
+#include "map.h"
+#include "render.h"
+#include "undo.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define CHUNKS_PER_SLAB 64
+#define DIRTY_WORDS ((MAX_VIEW_W + 63) / 64)
+
+chunk_t * chunks[CHUNKS_Y][CHUNKS_X];
+int num_chunks;
+
+int app_w = 80;
+int app_h = 25;
+
+int view_x;
+int view_y;
+int view_w;
+int view_h;
+
+int dirty_cells;
+int flushed_cells;
+int flushed_rects;
+
+// Chunks are carved out of slabs and recycled through a free list.
+static chunk_t ** slabs;
+static int num_slabs;
+static chunk_t * free_chunks;
+
+// One bit per visible cell, plus the dirty column span of each view row and
+// the dirty row span of the whole view, so flushing only looks at rows that
+// changed. All in view coordinates.
+static u64 dirty_bits[MAX_VIEW_H][DIRTY_WORDS];
+static s16 row_left[MAX_VIEW_H];
+static s16 row_right[MAX_VIEW_H];
+static int dirty_top = MAX_VIEW_H;
+static int dirty_bottom = -1;
+
+static chunk_t * AllocChunk(void)
+{
+    if ( free_chunks == NULL ) {
+        chunk_t * slab = malloc(CHUNKS_PER_SLAB * sizeof(*slab));
+        chunk_t ** new_slabs = realloc(slabs, (num_slabs + 1) * sizeof(*slabs));
+        if ( slab == NULL || new_slabs == NULL ) {
+            free(slab);
+            return NULL;
+        }
+
+        slabs = new_slabs;
+        slabs[num_slabs++] = slab;
+
+        for ( int i = 0; i < CHUNKS_PER_SLAB; i++ ) {
+            slab[i].next_free = free_chunks;
+            free_chunks = &slab[i];
+        }
+    }
+
+    chunk_t * chunk = free_chunks;
+    free_chunks = chunk->next_free;
+    memset(chunk->cells, 0, sizeof(chunk->cells));
+    num_chunks++;
+
+    return chunk;
+}
+
+// The chunk holding x, y, allocated if needed. NULL if out of memory.
+static chunk_t * GetChunk(int x, int y)
+{
+    chunk_t ** chunk = &chunks[y >> CHUNK_SHIFT][x >> CHUNK_SHIFT];
+    if ( *chunk == NULL ) {
+        *chunk = AllocChunk();
+        if ( *chunk == NULL ) {
+            printf("Out of memory for map chunks\n");
+        }
+    }
+
+    return *chunk;
+}
+
+void SetCell(int x, int y, u16 cell)
+{
+    if ( cell == 0 && chunks[y >> CHUNK_SHIFT][x >> CHUNK_SHIFT] == NULL ) {
+        return;
+    }
+
+    chunk_t * chunk = GetChunk(x, y);
+    if ( chunk ) {
+        u16 * c = &chunk->cells[y & CHUNK_MASK][x & CHUNK_MASK];
+        if ( recording && *c != cell ) {
+            RecordCell(x, y, *c, cell);
+        }
+        *c = cell;
+    }
+}
+
+void ReadCells(int x, int y, int count, u16 * out)
+{
+    while ( count > 0 ) {
+        int n = MIN(count, CHUNK_SIZE - (x & CHUNK_MASK));
+        const chunk_t * chunk = chunks[y >> CHUNK_SHIFT][x >> CHUNK_SHIFT];
+
+        if ( chunk ) {
+            memcpy(out, &chunk->cells[y & CHUNK_MASK][x & CHUNK_MASK], n * sizeof(*out));
+        } else {
+            memset(out, 0, n * sizeof(*out));
+        }
+
+        x += n;
+        out += n;
+        count -= n;
+    }
+}
+
+static bool IsBlank(const u16 * cells, int count)
+{
+    for ( int i = 0; i < count; i++ ) {
+        if ( cells[i] ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void WriteCells(int x, int y, int count, const u16 * in)
+{
+    while ( count > 0 ) {
+        int n = MIN(count, CHUNK_SIZE - (x & CHUNK_MASK));
+        chunk_t * chunk = chunks[y >> CHUNK_SHIFT][x >> CHUNK_SHIFT];
+
+        if ( chunk || !IsBlank(in, n) ) {
+            chunk = GetChunk(x, y);
+            if ( chunk ) {
+                u16 * cells = &chunk->cells[y & CHUNK_MASK][x & CHUNK_MASK];
+                if ( recording ) {
+                    for ( int i = 0; i < n; i++ ) {
+                        if ( cells[i] != in[i] ) {
+                            RecordCell(x + i, y, cells[i], in[i]);
+                        }
+                    }
+                }
+                memcpy(cells, in, n * sizeof(*in));
+            }
+        }
+
+        x += n;
+        in += n;
+        count -= n;
+    }
+}
+
+void ClearMap(void)
+{
+    memset(chunks, 0, sizeof(chunks));
+
+    for ( int i = 0; i < num_slabs; i++ ) {
+        free(slabs[i]);
+    }
+
+    free(slabs);
+    slabs = NULL;
+    num_slabs = 0;
+    free_chunks = NULL;
+    num_chunks = 0;
+}
+
+void UpdateMapPosition(int x, int y, u8 ch, u8 fg, u8 bg)
+{
+    u16 old = GetCell(x, y);
+    u16 cell = old;
+
+    SET_CHAR(cell, ch);
+    SET_FG(cell, fg);
+    SET_BG(cell, bg);
+
+    if ( cell != old ) {
+        SetCell(x, y, cell);
+        MarkDirty(x, y);
+    }
+}
+
+void SetView(int x, int y)
+{
+    int w = MIN(app_w, MAX_VIEW_W);
+    int h = MIN(app_h, MAX_VIEW_H);
+    x = MAX(0, MIN(x, app_w - w));
+    y = MAX(0, MIN(y, app_h - h));
+
+    if ( x != view_x || y != view_y ) {
+        view_x = x;
+        view_y = y;
+        view_w = w;
+        view_h = h;
+        MarkDirtyRect((SDL_Rect){ view_x, view_y, view_w, view_h });
+    } else if ( w != view_w || h != view_h ) {
+        // Resized in place: what's already drawn stays put.
+        int old_w = view_w;
+        int old_h = view_h;
+        view_w = w;
+        view_h = h;
+        MarkDirtyRect((SDL_Rect){ x + old_w, y, w - old_w, h });
+        MarkDirtyRect((SDL_Rect){ x, y + old_h, MIN(w, old_w), h - old_h });
+    }
+}
+
+void ScrollToCell(int x, int y)
+{
+    int new_x = view_x;
+    int new_y = view_y;
+
+    if ( x < view_x ) {
+        new_x = x;
+    } else if ( x >= view_x + view_w ) {
+        new_x = x - view_w + 1;
+    }
+
+    if ( y < view_y ) {
+        new_y = y;
+    } else if ( y >= view_y + view_h ) {
+        new_y = y - view_h + 1;
+    }
+
+    SetView(new_x, new_y);
+}
+
+static void MarkRowSpan(int y, int x1, int x2)
+{
+    for ( int x = x1; x <= x2; ) {
+        u64 * word = &dirty_bits[y][x / 64];
+        int first = x % 64;
+        int last = MIN(63, first + (x2 - x));
+        u64 bits = (last == 63 ? ~0ull : (1ull << (last + 1)) - 1) & ~((1ull << first) - 1);
+
+        dirty_cells += __builtin_popcountll(bits & ~*word);
+        *word |= bits;
+        x += last - first + 1;
+    }
+
+    row_left[y] = MIN(row_left[y], x1);
+    row_right[y] = MAX(row_right[y], x2);
+
+    dirty_top = MIN(dirty_top, y);
+    dirty_bottom = MAX(dirty_bottom, y);
+}
+
+void MarkDirtyRect(SDL_Rect r)
+{
+    // To view coordinates.
+    int x1 = MAX(r.x - view_x, 0);
+    int y1 = MAX(r.y - view_y, 0);
+    int x2 = MIN(r.x + r.w - view_x, view_w) - 1;
+    int y2 = MIN(r.y + r.h - view_y, view_h) - 1;
+
+    if ( x1 > x2 || y1 > y2 ) {
+        return;
+    }
+
+    static bool spans_initialized;
+    if ( !spans_initialized ) {
+        for ( int y = 0; y < MAX_VIEW_H; y++ ) {
+            row_left[y] = MAX_VIEW_W;
+            row_right[y] = -1;
+        }
+        spans_initialized = true;
+    }
+
+    for ( int y = y1; y <= y2; y++ ) {
+        MarkRowSpan(y, x1, x2);
+    }
+}
+
+void MarkDirty(int x, int y)
+{
+    MarkDirtyRect((SDL_Rect){ x, y, 1, 1 });
+}
+
+void FlushDirty(void)
+{
+    if ( dirty_bottom == -1 ) {
+        return;
+    }
+
+    // Merge vertically adjacent rows whose spans touch into one rectangle.
+    static SDL_Rect rects[MAX_VIEW_H];
+    int num_rects = 0;
+    SDL_Rect * r = NULL;
+
+    for ( int y = dirty_top; y <= dirty_bottom; y++ ) {
+        int left = row_left[y];
+        int right = row_right[y];
+
+        if ( left > right ) {
+            r = NULL;
+            continue;
+        }
+
+        memset(dirty_bits[y], 0, sizeof(dirty_bits[y]));
+        row_left[y] = MAX_VIEW_W;
+        row_right[y] = -1;
+
+        if ( r && left <= r->x + r->w && right >= r->x - 1 ) {
+            int x1 = MIN(r->x, left);
+            int x2 = MAX(r->x + r->w - 1, right);
+            r->x = x1;
+            r->w = x2 - x1 + 1;
+            r->h++;
+        } else {
+            r = &rects[num_rects++];
+            *r = (SDL_Rect){ left, y, right - left + 1, 1 };
+        }
+    }
+
+    // Gather just the rectangles from the chunks under them.
+    static u16 view_cells[MAX_VIEW_H][MAX_VIEW_W];
+    for ( int i = 0; i < num_rects; i++ ) {
+        for ( int y = rects[i].y; y < rects[i].y + rects[i].h; y++ ) {
+            ReadCells(view_x + rects[i].x,
+                      view_y + y,
+                      rects[i].w,
+                      &view_cells[y][rects[i].x]);
+        }
+    }
+
+    DrawMapRegions(&view_cells[0][0], MAX_VIEW_W, rects, num_rects);
+
+    flushed_cells = dirty_cells;
+    flushed_rects = num_rects;
+    dirty_cells = 0;
+    dirty_top = MAX_VIEW_H;
+    dirty_bottom = -1;
+}
@@ -0,0 +1,96 @@
+//
+//  map.h
+//  TextAppMaker
+//
+//  The work area cells, the part of them that is in view, and tracking of
+//  which visible cells need to be redrawn into the map texture.
+//
+//  Cells are stored sparsely in CHUNK_SIZE x CHUNK_SIZE chunks that are only
+//  allocated once something other than a blank (zero) cell is written to
+//  them, so memory follows the painted area rather than the canvas size.
+//
+
+#ifndef map_h
+#define map_h
+
+#include "common.h"
+
+#define MAX_WIDTH 4096
+#define MAX_HEIGHT 4096
+
+// The most cells the window shows at once.
+#define MAX_VIEW_W 96
+#define MAX_VIEW_H 32
+
+#define CHUNK_SHIFT 5
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define CHUNKS_X (MAX_WIDTH / CHUNK_SIZE)
+#define CHUNKS_Y (MAX_HEIGHT / CHUNK_SIZE)
+
+typedef struct chunk {
+    u16 cells[CHUNK_SIZE][CHUNK_SIZE];
+    struct chunk * next_free;
+} chunk_t;
+
+extern chunk_t * chunks[CHUNKS_Y][CHUNKS_X];
+extern int num_chunks; // Allocated
+
+extern int app_w;
+extern int app_h;
+
+// Visible part of the map, in cells.
+extern int view_x;
+extern int view_y;
+extern int view_w;
+extern int view_h;
+
+// Cells currently waiting for FlushDirty.
+extern int dirty_cells;
+
+// What the most recent non-empty FlushDirty redrew.
+extern int flushed_cells;
+extern int flushed_rects;
+
+/// x and y must be within MAX_WIDTH x MAX_HEIGHT.
+static inline u16 GetCell(int x, int y)
+{
+    const chunk_t * chunk = chunks[y >> CHUNK_SHIFT][x >> CHUNK_SHIFT];
+    return chunk ? chunk->cells[y & CHUNK_MASK][x & CHUNK_MASK] : 0;
+}
+
+/// Set a cell without marking it dirty. x and y must be within MAX_WIDTH x
+/// MAX_HEIGHT. Changes are recorded in the undo history while an edit is
+/// open, as are those made by WriteCells.
+void SetCell(int x, int y, u16 cell);
+
+/// Copy `count` cells of row y, starting at x, to `out`.
+void ReadCells(int x, int y, int count, u16 * out);
+
+/// Copy `count` cells from `in` to row y, starting at x, without marking them
+/// dirty.
+void WriteCells(int x, int y, int count, const u16 * in);
+
+/// Blank the whole map and release all chunks.
+void ClearMap(void);
+
+void UpdateMapPosition(int x, int y, u8 ch, u8 fg, u8 bg);
+
+/// Set the view size to fit the map, then scroll so that x, y is the top-left
+/// visible cell, as far as the map allows. Marks the whole view dirty when it
+/// scrolls, or just the newly exposed cells when only its size changes.
+void SetView(int x, int y);
+
+/// Scroll the least distance that brings map cell x, y into view.
+void ScrollToCell(int x, int y);
+
+/// Mark map cells whose texture contents are out of date. Cells outside the
+/// view are ignored.
+void MarkDirty(int x, int y);
+void MarkDirtyRect(SDL_Rect r);
+
+/// Merge all dirty cells into rectangles and redraw them with a single render
+/// target bind. Call once per frame, before the map texture is drawn.
+void FlushDirty(void);
+
+#endif /* map_h */
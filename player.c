@@ -0,0 +1,195 @@
+//
+//  player.c
+//  TextAppMaker
+//
+
+#include "player.h"
+#include "ansi.h"
+#include "charset.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes a cell can take: a cursor move, a color change and a glyph.
+#define MAX_CELL_BYTES (2 * ANSI_MAX_SEQUENCE + 4)
+
+// A cell reduced to what it looks like, so e.g. spaces in different
+// foreground colors compare equal.
+static u16 Visible(u16 cell)
+{
+    int ch = GET_CHAR(cell);
+
+    if ( IsBlankGlyph(ch) ) {
+        return cell & 0xF000;
+    } else if ( ch == 219 ) {
+        return cell & 0x0FFF;
+    }
+
+    return cell;
+}
+
+void InitPlayer(player_t * player, FILE * out)
+{
+    *player = (player_t){ .out = out };
+}
+
+void FreePlayer(player_t * player)
+{
+    free(player->shown);
+    free(player->buffer);
+    *player = (player_t){ 0 };
+}
+
+void ResetPlayer(player_t * player)
+{
+    player->valid = false;
+}
+
+static void Put(player_t * player, const char * s, size_t length)
+{
+    memcpy(player->buffer + player->used, s, length);
+    player->used += length;
+}
+
+static void PutCell(player_t * player, u16 cell)
+{
+    player->used += FormatColors(player->buffer + player->used,
+                                 cell,
+                                 &player->fg,
+                                 &player->bg);
+
+    int length;
+    const char * utf8 = CP437ToUTF8((u8)GET_CHAR(cell), &length);
+    Put(player, utf8, length);
+
+    // At the right edge the terminal's cursor waits to wrap, which is
+    // easier to not rely on. It stays on the row.
+    if ( ++player->cursor_x == player->w ) {
+        player->cursor_x = -1;
+    }
+}
+
+// Get the cursor to x, y on row `cells`, which the terminal already shows
+// left of x.
+static void MoveTo(player_t * player, const u16 * cells, int x, int y)
+{
+    if ( player->cursor_y == y && player->cursor_x == x ) {
+        return;
+    }
+
+    char move[ANSI_MAX_SEQUENCE];
+    int move_length;
+    int cursor_x = player->cursor_x;
+
+    if ( x == 0 && y > 0 && player->cursor_y == y - 1 ) {
+        move_length = sprintf(move, "\r\n");
+    } else if ( cursor_x == -1 || player->cursor_y != y ) {
+        move_length = FormatCursor(move, x, y);
+    } else if ( cursor_x < x ) {
+        // Either skip over the cells in between or write them again,
+        // whichever is shorter.
+        move_length = sprintf(move, "\x1b[%dC", x - cursor_x);
+
+        size_t start = player->used;
+        int fg = player->fg;
+        int bg = player->bg;
+        for ( int i = cursor_x; i < x && player->used - start <= (size_t)move_length; i++ ) {
+            PutCell(player, cells[i]);
+        }
+
+        if ( player->used - start <= (size_t)move_length ) {
+            return;
+        }
+
+        player->used = start;
+        player->fg = fg;
+        player->bg = bg;
+    } else if ( x == 0 ) {
+        move_length = sprintf(move, "\r");
+    } else {
+        move_length = sprintf(move, "\x1b[%dD", cursor_x - x);
+    }
+
+    Put(player, move, move_length);
+    player->cursor_x = x;
+    player->cursor_y = y;
+}
+
+static bool Resize(player_t * player, int w, int h)
+{
+    size_t capacity = (size_t)w * h * MAX_CELL_BYTES + 64;
+    u16 * shown = realloc(player->shown, (size_t)w * h * sizeof(*shown));
+    char * buffer = shown ? realloc(player->buffer, capacity) : NULL;
+
+    if ( shown ) {
+        player->shown = shown;
+    }
+
+    if ( buffer == NULL ) {
+        printf("Error: out of memory for a %d x %d frame\n", w, h);
+        return false;
+    }
+
+    player->buffer = buffer;
+    player->capacity = capacity;
+    player->w = w;
+    player->h = h;
+    player->valid = false;
+    return true;
+}
+
+bool PresentFrame(player_t * player, const u16 * cells, int pitch, int w, int h)
+{
+    if ( w != player->w || h != player->h || player->shown == NULL ) {
+        if ( !Resize(player, w, h) ) {
+            return false;
+        }
+    }
+
+    player->used = 0;
+    player->frame_cells = 0;
+
+    if ( !player->valid ) {
+        // A cleared terminal shows blanks on the default background, which
+        // is taken to be palette 0.
+        static const char clear[] = "\x1b[0m\x1b[2J";
+        Put(player, clear, sizeof(clear) - 1);
+        memset(player->shown, 0, (size_t)w * h * sizeof(*player->shown));
+        player->fg = 7;
+        player->bg = 0;
+        player->cursor_x = -1;
+        player->cursor_y = -1;
+        player->valid = true;
+    }
+
+    for ( int y = 0; y < h; y++ ) {
+        const u16 * row = &cells[y * pitch];
+        u16 * shown = &player->shown[y * w];
+
+        for ( int x = 0; x < w; x++ ) {
+            u16 visible = Visible(row[x]);
+            if ( visible == shown[x] ) {
+                continue;
+            }
+
+            MoveTo(player, row, x, y);
+            PutCell(player, row[x]);
+            shown[x] = visible;
+            player->frame_cells++;
+        }
+    }
+
+    player->frame_bytes = player->used;
+    if ( player->used == 0 ) {
+        return true;
+    }
+
+    if ( fwrite(player->buffer, 1, player->used, player->out) != player->used
+        || fflush(player->out) != 0 )
+    {
+        player->valid = false;
+        return false;
+    }
+
+    return true;
+}
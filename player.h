@@ -0,0 +1,50 @@
+//
+//  player.h
+//  TextAppMaker
+//
+//  Shows screens in a real terminal. The player remembers what the terminal
+//  shows, and each new frame only writes the cells that look different,
+//  with the cheapest cursor moves and color changes it can find. A whole
+//  frame goes out in one write.
+//
+
+#ifndef player_h
+#define player_h
+
+#include "common.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct {
+    FILE * out;
+    int w;
+    int h;
+    u16 * shown;        // What the terminal shows, see Visible() in player.c
+    bool valid;         // False until the terminal has been cleared
+
+    int cursor_x;       // -1 if not known
+    int cursor_y;
+    int fg;
+    int bg;
+
+    char * buffer;
+    size_t used;
+    size_t capacity;
+
+    size_t frame_bytes; // Written for the last frame
+    int frame_cells;    // Cells changed by the last frame
+} player_t;
+
+void InitPlayer(player_t * player, FILE * out);
+void FreePlayer(player_t * player);
+
+/// Make the terminal show the w x h `cells` (`pitch` cells per row). A frame
+/// of a different size than the last clears the terminal first. Returns
+/// false if out of memory or the write failed.
+bool PresentFrame(player_t * player, const u16 * cells, int pitch, int w, int h);
+
+/// Forget what the terminal shows, so the next frame is drawn in full, e.g.
+/// after something else wrote to it.
+void ResetPlayer(player_t * player);
+
+#endif /* player_h */
@@ -0,0 +1,401 @@
+//
+//  png.c
+//  TextAppMaker
+//
+//  Deflate here is LZ77 with a one-entry hash per position and the fixed
+//  Huffman codes. Rasterized text repeats a lot, both along rows and
+//  between scaled rows, so that already gets most of the way.
+//
+
+#include "png.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WINDOW_SIZE 32768
+#define HASH_BITS 15
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define ADLER_BASE 65521
+
+typedef struct {
+    u8 * data;
+    size_t size;
+    size_t capacity;
+    u64 bits;
+    int num_bits;
+    bool failed;
+} bit_writer_t;
+
+// Lengths 3-258 and distances 1-32768 as code, extra bits and base.
+static const u16 length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const u8 length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const u16 distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const u8 distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static u32 crc_table[256];
+
+// The fixed Huffman codes, already bit reversed, and which length and
+// distance code each length and distance uses (the latter indexed as in
+// zlib: distances up to 256 directly, longer ones by 128s from 256 on).
+static u16 symbol_code[288];
+static u8 symbol_bits[288];
+static u8 distance_code_bits[30];
+static u8 length_code[MAX_MATCH + 1];
+static u8 distance_code[512];
+
+static SDL_SpinLock tables_lock;
+static bool tables_ready;
+
+// Huffman codes are sent most significant bit first.
+static u32 Reverse(u32 code, int length)
+{
+    u32 r = 0;
+    for ( int i = 0; i < length; i++ ) {
+        r = r << 1 | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+static void InitTables(void)
+{
+    SDL_AtomicLock(&tables_lock);
+
+    if ( !tables_ready ) {
+        for ( u32 n = 0; n < 256; n++ ) {
+            u32 c = n;
+            for ( int k = 0; k < 8; k++ ) {
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            crc_table[n] = c;
+        }
+
+        for ( int s = 0; s < 288; s++ ) {
+            if ( s < 144 ) {
+                symbol_code[s] = Reverse(0x30 + s, 8);
+                symbol_bits[s] = 8;
+            } else if ( s < 256 ) {
+                symbol_code[s] = Reverse(0x190 + s - 144, 9);
+                symbol_bits[s] = 9;
+            } else if ( s < 280 ) {
+                symbol_code[s] = Reverse(s - 256, 7);
+                symbol_bits[s] = 7;
+            } else {
+                symbol_code[s] = Reverse(0xC0 + s - 280, 8);
+                symbol_bits[s] = 8;
+            }
+        }
+
+        for ( int code = 0; code < 30; code++ ) {
+            distance_code_bits[code] = Reverse(code, 5);
+        }
+
+        for ( int code = 0; code < 29; code++ ) {
+            int end = code < 28 ? length_base[code + 1] : MAX_MATCH + 1;
+            for ( int length = length_base[code]; length < end; length++ ) {
+                length_code[length] = code;
+            }
+        }
+
+        for ( int code = 0; code < 30; code++ ) {
+            int end = code < 29 ? distance_base[code + 1] : WINDOW_SIZE + 1;
+            for ( int distance = distance_base[code]; distance < end; distance++ ) {
+                int index = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+                distance_code[index] = code;
+            }
+        }
+
+        tables_ready = true;
+    }
+
+    SDL_AtomicUnlock(&tables_lock);
+}
+
+static u32 Crc(u32 crc, const u8 * data, size_t size)
+{
+    crc = ~crc;
+    for ( size_t i = 0; i < size; i++ ) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static u32 Adler(const u8 * data, size_t size)
+{
+    u32 a = 1;
+    u32 b = 0;
+
+    while ( size > 0 ) {
+        // The most bytes before b could overflow.
+        size_t n = MIN(size, 5552);
+        for ( size_t i = 0; i < n; i++ ) {
+            a += data[i];
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+        data += n;
+        size -= n;
+    }
+
+    return b << 16 | a;
+}
+
+// The Adler-32 of two buffers joined, from theirs and the second's length,
+// as zlib's adler32_combine().
+static u32 CombineAdler(u32 adler1, u32 adler2, size_t size2)
+{
+    u32 rem = (u32)(size2 % ADLER_BASE);
+    u32 sum1 = adler1 & 0xFFFF;
+    u32 sum2 = (rem * sum1) % ADLER_BASE;
+    sum1 += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+
+    if ( sum1 >= ADLER_BASE ) sum1 -= ADLER_BASE;
+    if ( sum1 >= ADLER_BASE ) sum1 -= ADLER_BASE;
+    if ( sum2 >= ADLER_BASE * 2 ) sum2 -= ADLER_BASE * 2;
+    if ( sum2 >= ADLER_BASE ) sum2 -= ADLER_BASE;
+
+    return sum2 << 16 | sum1;
+}
+
+// Make room for `count` more bytes.
+static bool Reserve(bit_writer_t * w, size_t count)
+{
+    if ( w->failed ) {
+        return false;
+    }
+
+    if ( w->size + count > w->capacity ) {
+        size_t new_capacity = w->capacity ? w->capacity * 2 : 65536;
+        u8 * new_data = realloc(w->data, new_capacity);
+        if ( new_data == NULL ) {
+            w->failed = true;
+            return false;
+        }
+        w->data = new_data;
+        w->capacity = new_capacity;
+    }
+
+    return true;
+}
+
+static inline void PutBits(bit_writer_t * w, u32 bits, int count)
+{
+    w->bits |= (u64)bits << w->num_bits;
+    w->num_bits += count;
+
+    if ( w->num_bits >= 32 ) {
+        if ( Reserve(w, 4) ) {
+            for ( int i = 0; i < 4; i++ ) {
+                w->data[w->size++] = (u8)(w->bits >> (i * 8));
+            }
+        }
+
+        w->bits >>= 32;
+        w->num_bits -= 32;
+    }
+}
+
+// Pad to a byte boundary and write out what's left.
+static void FlushBits(bit_writer_t * w)
+{
+    while ( w->num_bits > 0 ) {
+        if ( Reserve(w, 1) ) {
+            w->data[w->size++] = (u8)w->bits;
+        }
+
+        w->bits >>= 8;
+        w->num_bits = MAX(w->num_bits - 8, 0);
+    }
+}
+
+static inline void PutSymbol(bit_writer_t * w, int symbol)
+{
+    PutBits(w, symbol_code[symbol], symbol_bits[symbol]);
+}
+
+static void PutMatch(bit_writer_t * w, int length, int distance)
+{
+    int code = length_code[length];
+    PutSymbol(w, 257 + code);
+    PutBits(w, length - length_base[code], length_extra[code]);
+
+    code = distance_code[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+    PutBits(w, distance_code_bits[code], 5);
+    PutBits(w, distance - distance_base[code], distance_extra[code]);
+}
+
+static u32 Hash(const u8 * p)
+{
+    return ((u32)p[0] << 16 | (u32)p[1] << 8 | p[2]) * 2654435761u >> (32 - HASH_BITS);
+}
+
+bool CompressPart(png_part_t * part, const u8 * raw, size_t size, bool last)
+{
+    InitTables();
+    *part = (png_part_t){ .raw_size = size, .adler = Adler(raw, size) };
+
+    int * head = malloc((1 << HASH_BITS) * sizeof(*head));
+    if ( head == NULL ) {
+        return false;
+    }
+    for ( int i = 0; i < 1 << HASH_BITS; i++ ) {
+        head[i] = -WINDOW_SIZE;
+    }
+
+    bit_writer_t w = { 0 };
+    PutBits(&w, last ? 1 : 0, 1);   // BFINAL
+    PutBits(&w, 1, 2);              // Fixed Huffman codes
+
+    size_t i = 0;
+    while ( i < size ) {
+        int length = 0;
+        size_t distance = 0;
+
+        if ( i + MIN_MATCH <= size ) {
+            u32 h = Hash(raw + i);
+            long candidate = head[h];
+            head[h] = (int)i;
+
+            distance = i - candidate;
+            if ( candidate >= 0 && distance <= WINDOW_SIZE ) {
+                size_t max = MIN(size - i, (size_t)MAX_MATCH);
+                const u8 * a = raw + i;
+                const u8 * b = raw + candidate;
+                while ( (size_t)length < max && a[length] == b[length] ) {
+                    length++;
+                }
+            }
+        }
+
+        if ( length >= MIN_MATCH ) {
+            PutMatch(&w, length, (int)distance);
+            // Only the start of a match goes into the hash, which is plenty
+            // for runs and repeated rows and keeps long matches cheap.
+            i += length;
+        } else {
+            PutSymbol(&w, raw[i]);
+            i++;
+        }
+    }
+
+    PutSymbol(&w, 256); // End of block
+
+    // Parts other than the last end on a byte boundary, by way of an empty
+    // stored block, so the next part's blocks can follow directly.
+    if ( !last ) {
+        PutBits(&w, 0, 3);
+        FlushBits(&w);
+        PutBits(&w, 0x0000, 16);
+        PutBits(&w, 0xFFFF, 16);
+    }
+
+    FlushBits(&w);
+    free(head);
+
+    if ( w.failed ) {
+        free(w.data);
+        return false;
+    }
+
+    part->data = w.data;
+    part->size = w.size;
+    return true;
+}
+
+void FreePart(png_part_t * part)
+{
+    free(part->data);
+    *part = (png_part_t){ 0 };
+}
+
+static void PutU32(u8 * p, u32 value)
+{
+    p[0] = (u8)(value >> 24);
+    p[1] = (u8)(value >> 16);
+    p[2] = (u8)(value >> 8);
+    p[3] = (u8)value;
+}
+
+static bool WriteChunk(FILE * file, const char * type, const u8 * data, size_t size)
+{
+    u8 header[8];
+    PutU32(header, (u32)size);
+    memcpy(header + 4, type, 4);
+
+    u8 crc[4];
+    PutU32(crc, Crc(Crc(0, header + 4, 4), data, size));
+
+    return fwrite(header, 1, 8, file) == 8
+        && fwrite(data, 1, size, file) == size
+        && fwrite(crc, 1, 4, file) == 4;
+}
+
+bool WritePNG(FILE * file, int w, int h, const png_part_t * parts, int num_parts)
+{
+    InitTables();
+
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    u8 ihdr[13];
+    PutU32(ihdr, (u32)w);
+    PutU32(ihdr + 4, (u32)h);
+    ihdr[8] = 4;    // Bit depth
+    ihdr[9] = 3;    // Paletted
+    ihdr[10] = 0;   // Deflate
+    ihdr[11] = 0;   // Adaptive filtering
+    ihdr[12] = 0;   // Not interlaced
+
+    u8 plte[16 * 3];
+    for ( int i = 0; i < 16; i++ ) {
+        plte[i * 3 + 0] = palette[i].r;
+        plte[i * 3 + 1] = palette[i].g;
+        plte[i * 3 + 2] = palette[i].b;
+    }
+
+    // One IDAT: the zlib header, every part, then the Adler-32 of all the
+    // raw data.
+    size_t size = 2 + 4;
+    u32 adler = 1;
+    for ( int i = 0; i < num_parts; i++ ) {
+        size += parts[i].size;
+        adler = CombineAdler(adler, parts[i].adler, parts[i].raw_size);
+    }
+
+    u8 * idat = malloc(size);
+    if ( idat == NULL ) {
+        return false;
+    }
+
+    u8 * p = idat;
+    *p++ = 0x78;    // Deflate, 32K window
+    *p++ = 0x01;    // No dictionary, fastest
+    for ( int i = 0; i < num_parts; i++ ) {
+        memcpy(p, parts[i].data, parts[i].size);
+        p += parts[i].size;
+    }
+    PutU32(p, adler);
+
+    bool ok = fwrite(signature, 1, sizeof(signature), file) == sizeof(signature)
+        && WriteChunk(file, "IHDR", ihdr, sizeof(ihdr))
+        && WriteChunk(file, "PLTE", plte, sizeof(plte))
+        && WriteChunk(file, "IDAT", idat, size)
+        && WriteChunk(file, "IEND", NULL, 0);
+
+    free(idat);
+    return ok;
+}
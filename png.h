@@ -0,0 +1,32 @@
+//
+//  png.h
+//  TextAppMaker
+//
+//  A small PNG encoder for 4-bit images in the editor's palette. The image
+//  data can be compressed in independent parts, e.g. one per thread, which
+//  are then joined into a single zlib stream.
+//
+
+#ifndef png_h
+#define png_h
+
+#include "common.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct {
+    u8 * data;          // Deflate blocks
+    size_t size;
+    size_t raw_size;    // Bytes compressed
+    u32 adler;          // Adler-32 of those bytes
+} png_part_t;
+
+/// Compress `size` bytes of filtered scanlines, each a filter type byte and
+/// the row, into `part`. `last` marks the part that ends the image.
+bool CompressPart(png_part_t * part, const u8 * raw, size_t size, bool last);
+void FreePart(png_part_t * part);
+
+/// Write a w x h 4-bit paletted PNG whose image data is `parts`, in order.
+bool WritePNG(FILE * file, int w, int h, const png_part_t * parts, int num_parts);
+
+#endif /* png_h */
@@ -0,0 +1,186 @@
+//
+//  profile.c
+//  TextAppMaker
+//
+
+#include "profile.h"
+#include "text.h"
+#include "map.h"
+#include "worker.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    u32 ticks;                  // When it ended
+    float ms[NUM_PHASES];
+    int counts[NUM_COUNTS];
+} frame_t;
+
+static const char * phase_names[NUM_PHASES] = {
+    [PHASE_EVENTS] = "events",
+    [PHASE_TEXTURE] = "texture",
+    [PHASE_PALETTE] = "palette",
+    [PHASE_OVERLAY] = "overlay",
+    [PHASE_PRESENT] = "present",
+};
+
+int frame_counts[NUM_COUNTS];
+
+static frame_t frames[PROFILE_FRAMES];
+static int num_frames; // Ever ended
+static frame_t current;
+static u64 phase_start[NUM_PHASES];
+static double ms_per_count;
+
+void BeginPhase(int phase)
+{
+    phase_start[phase] = SDL_GetPerformanceCounter();
+}
+
+void EndPhase(int phase)
+{
+    if ( ms_per_count == 0.0 ) {
+        ms_per_count = 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+    u64 elapsed = SDL_GetPerformanceCounter() - phase_start[phase];
+    current.ms[phase] += (float)(elapsed * ms_per_count);
+}
+
+void EndFrame(void)
+{
+    current.ticks = SDL_GetTicks();
+    memcpy(current.counts, frame_counts, sizeof(current.counts));
+    frames[num_frames % PROFILE_FRAMES] = current;
+    num_frames++;
+
+    memset(&current, 0, sizeof(current));
+    memset(frame_counts, 0, sizeof(frame_counts));
+}
+
+static float FrameTotal(const frame_t * frame)
+{
+    float total = 0.0f;
+    for ( int i = 0; i < NUM_PHASES; i++ ) {
+        total += frame->ms[i];
+    }
+
+    return total;
+}
+
+static int CompareFloats(const void * a, const void * b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of the `count` sorted `values`.
+static float Percentile(const float * values, int count, int percent)
+{
+    int rank = (count * percent + 99) / 100;
+    return values[MAX(rank, 1) - 1];
+}
+
+// The phase's times, or the frame totals for NUM_PHASES, over the window,
+// sorted.
+static int SortedTimes(int phase, float * out)
+{
+    int count = MIN(num_frames, PROFILE_WINDOW);
+    for ( int i = 0; i < count; i++ ) {
+        const frame_t * frame = &frames[(num_frames - 1 - i) % PROFILE_FRAMES];
+        out[i] = phase == NUM_PHASES ? FrameTotal(frame) : frame->ms[phase];
+    }
+
+    qsort(out, count, sizeof(*out), CompareFloats);
+    return count;
+}
+
+void RenderProfile(int x, int y)
+{
+    if ( num_frames == 0 ) {
+        return;
+    }
+
+    int saved_counts[NUM_COUNTS];
+    memcpy(saved_counts, frame_counts, sizeof(saved_counts));
+
+    const int lines = NUM_PHASES + 6;
+    SDL_Rect background = { x, y, 26 * FONT_W, lines * FONT_H };
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 192);
+    SDL_RenderFillRect(renderer, &background);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+
+    PrintString(x, y, "%-8s %5s %5s %5s", "ms", "p50", "p95", "p99");
+
+    float times[PROFILE_WINDOW];
+    for ( int i = 0; i <= NUM_PHASES; i++ ) {
+        int count = SortedTimes(i, times);
+        PrintString(x,
+                    y + (i + 1) * FONT_H,
+                    "%-8s %5.2f %5.2f %5.2f",
+                    i == NUM_PHASES ? "total" : phase_names[i],
+                    Percentile(times, count, 50),
+                    Percentile(times, count, 95),
+                    Percentile(times, count, 99));
+    }
+
+    const frame_t * last = &frames[(num_frames - 1) % PROFILE_FRAMES];
+    PrintString(x,
+                y + (NUM_PHASES + 2) * FONT_H,
+                "%d chars %d targets",
+                last->counts[COUNT_PRINT_CHARS],
+                last->counts[COUNT_TARGET_SWITCHES]);
+    PrintString(x,
+                y + (NUM_PHASES + 3) * FONT_H,
+                "flush %dc %dr",
+                flushed_cells,
+                flushed_rects);
+
+    // The worker allocates chunks while it has the map.
+    if ( !WorkerBusy() ) {
+        PrintString(x, y + (NUM_PHASES + 4) * FONT_H, "%d chunks", num_chunks);
+    }
+
+    memcpy(frame_counts, saved_counts, sizeof(frame_counts));
+}
+
+bool DumpProfile(const char * path)
+{
+    FILE * file = fopen(path, "w");
+    if ( file == NULL ) {
+        printf("Failed to create '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(file, "frame,ticks");
+    for ( int i = 0; i < NUM_PHASES; i++ ) {
+        fprintf(file, ",%s_ms", phase_names[i]);
+    }
+    fprintf(file, ",total_ms,print_chars,target_switches\n");
+
+    int count = MIN(num_frames, PROFILE_FRAMES);
+    for ( int i = num_frames - count; i < num_frames; i++ ) {
+        const frame_t * frame = &frames[i % PROFILE_FRAMES];
+        fprintf(file, "%d,%u", i, frame->ticks);
+        for ( int j = 0; j < NUM_PHASES; j++ ) {
+            fprintf(file, ",%.3f", frame->ms[j]);
+        }
+        fprintf(file,
+                ",%.3f,%d,%d\n",
+                FrameTotal(frame),
+                frame->counts[COUNT_PRINT_CHARS],
+                frame->counts[COUNT_TARGET_SWITCHES]);
+    }
+
+    if ( fclose(file) != 0 ) {
+        printf("Failed to write '%s'\n", path);
+        return false;
+    }
+
+    printf("Wrote %d frames to '%s'\n", count, path);
+    return true;
+}
@@ -0,0 +1,63 @@
+//
+//  profile.h
+//  TextAppMaker
+//
+//  Where the frame time goes: timers around each phase of the main loop and
+//  counters of costly calls, kept for the most recent frames. Shown as an
+//  overlay with rolling percentiles, and dumped as CSV.
+//
+
+#ifndef profile_h
+#define profile_h
+
+#include "common.h"
+#include <stdbool.h>
+
+// Frames kept for the CSV dump, and the most recent of them the percentiles
+// cover.
+#define PROFILE_FRAMES 1024
+#define PROFILE_WINDOW 120
+
+enum {
+    PHASE_EVENTS,   // Handling input
+    PHASE_TEXTURE,  // Background, map texture refresh and copy
+    PHASE_PALETTE,  // Character palette
+    PHASE_OVERLAY,  // Selection, cursors and status text
+    PHASE_PRESENT,  // SDL_RenderPresent
+    NUM_PHASES,
+};
+
+enum {
+    COUNT_PRINT_CHARS,
+    COUNT_TARGET_SWITCHES,
+    NUM_COUNTS,
+};
+
+/// Counters for the frame in progress. Incremented where the calls are made.
+extern int frame_counts[NUM_COUNTS];
+
+/// Time between BeginPhase and EndPhase is added to the phase's total for
+/// the frame in progress. A phase may be timed more than once per frame.
+void BeginPhase(int phase);
+void EndPhase(int phase);
+
+/// Store the frame's times and counts and start a new one.
+void EndFrame(void);
+
+/// SDL_SetRenderTarget, counted.
+static inline int SetRenderTarget(SDL_Texture * texture)
+{
+    frame_counts[COUNT_TARGET_SWITCHES]++;
+    return SDL_SetRenderTarget(renderer, texture);
+}
+
+/// Draw the 50th, 95th and 99th percentile of each phase over the last
+/// PROFILE_WINDOW frames, with pixel x, y top-left. Not counted in the frame's
+/// counts itself.
+void RenderProfile(int x, int y);
+
+/// Write the stored frames to `path`, oldest first, one per line. Prints why
+/// and returns false on failure.
+bool DumpProfile(const char * path);
+
+#endif /* profile_h */
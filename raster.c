@@ -0,0 +1,121 @@
+//
+//  raster.c
+//  TextAppMaker
+//
+
+#include "raster.h"
+#include "cp437.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#define RASTER_X86
+#endif
+
+// Each glyph row byte expanded to eight all-ones / all-zeros pixel masks.
+static _Alignas(32) u32 expand[256][8];
+static u32 palette_pixels[16];
+
+typedef void (* blit_t)(u32 * dst, int pitch, const u8 * bits, u32 fg, u32 bg);
+static blit_t BlitGlyph;
+
+static void BlitGlyphScalar(u32 * dst, int pitch, const u8 * bits, u32 fg, u32 bg)
+{
+    for ( int row = 0; row < FONT_H; row++ ) {
+        const u32 * mask = expand[bits[row]];
+        for ( int col = 0; col < FONT_W; col++ ) {
+            dst[col] = (fg & mask[col]) | (bg & ~mask[col]);
+        }
+        dst += pitch;
+    }
+}
+
+#ifdef RASTER_X86
+#ifdef __SSE2__
+static void BlitGlyphSSE2(u32 * dst, int pitch, const u8 * bits, u32 fg, u32 bg)
+{
+    __m128i f = _mm_set1_epi32((int)fg);
+    __m128i b = _mm_set1_epi32((int)bg);
+
+    for ( int row = 0; row < FONT_H; row++ ) {
+        const __m128i * mask = (const __m128i *)expand[bits[row]];
+        __m128i m0 = _mm_load_si128(mask);
+        __m128i m1 = _mm_load_si128(mask + 1);
+        _mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_and_si128(m0, f), _mm_andnot_si128(m0, b)));
+        _mm_storeu_si128((__m128i *)(dst + 4), _mm_or_si128(_mm_and_si128(m1, f), _mm_andnot_si128(m1, b)));
+        dst += pitch;
+    }
+}
+#endif
+
+__attribute__((target("avx2")))
+static void BlitGlyphAVX2(u32 * dst, int pitch, const u8 * bits, u32 fg, u32 bg)
+{
+    __m256i f = _mm256_set1_epi32((int)fg);
+    __m256i b = _mm256_set1_epi32((int)bg);
+
+    for ( int row = 0; row < FONT_H; row++ ) {
+        __m256i m = _mm256_load_si256((const __m256i *)expand[bits[row]]);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_blendv_epi8(b, f, m));
+        dst += pitch;
+    }
+}
+#endif
+
+void InitRaster(void)
+{
+    if ( BlitGlyph ) {
+        return;
+    }
+
+    for ( int byte = 0; byte < 256; byte++ ) {
+        for ( int col = 0; col < FONT_W; col++ ) {
+            expand[byte][col] = byte & (0x80 >> col) ? 0xFFFFFFFF : 0;
+        }
+    }
+
+    for ( int i = 0; i < 16; i++ ) {
+        SDL_Color c = palette[i];
+        palette_pixels[i] = (u32)c.r << 24 | (u32)c.g << 16 | (u32)c.b << 8 | 0xFF;
+    }
+
+    BlitGlyph = BlitGlyphScalar;
+#ifdef RASTER_X86
+#ifdef __SSE2__
+    BlitGlyph = BlitGlyphSSE2;
+#endif
+    if ( SDL_HasAVX2() ) {
+        BlitGlyph = BlitGlyphAVX2;
+    }
+#endif
+}
+
+u32 PalettePixel(int index)
+{
+    return palette_pixels[index];
+}
+
+void RasterCells(u32 * pixels,
+                 int pixel_pitch,
+                 const u16 * cells,
+                 int cell_pitch,
+                 SDL_Rect region,
+                 int dst_x,
+                 int dst_y)
+{
+    InitRaster();
+
+    for ( int y = 0; y < region.h; y++ ) {
+        const u16 * row = &cells[(region.y + y) * cell_pitch + region.x];
+        u32 * dst = &pixels[(dst_y + y * FONT_H) * pixel_pitch + dst_x];
+
+        for ( int x = 0; x < region.w; x++ ) {
+            u16 cell = row[x];
+            BlitGlyph(dst,
+                      pixel_pitch,
+                      &cp437[GET_CHAR(cell) * FONT_H],
+                      palette_pixels[GET_FG(cell)],
+                      palette_pixels[GET_BG(cell)]);
+            dst += FONT_W;
+        }
+    }
+}
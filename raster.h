@@ -0,0 +1,31 @@
+//
+//  raster.h
+//  TextAppMaker
+//
+//  CPU glyph blitter. Rasterizes cells into a 32-bit RGBA8888 pixel buffer
+//  without touching the renderer, so the result doesn't depend on the GPU
+//  driver.
+//
+
+#ifndef raster_h
+#define raster_h
+
+#include "common.h"
+
+void InitRaster(void);
+
+/// Rasterize the cells in `region` of a `cell_pitch`-wide cell array into
+/// `pixels` (`pixel_pitch` pixels per row), with the region's top-left cell
+/// at pixel (dst_x, dst_y).
+void RasterCells(u32 * pixels,
+                 int pixel_pitch,
+                 const u16 * cells,
+                 int cell_pitch,
+                 SDL_Rect region,
+                 int dst_x,
+                 int dst_y);
+
+/// Palette entry `index` as an RGBA8888 pixel.
+u32 PalettePixel(int index);
+
+#endif /* raster_h */
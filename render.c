@@ -0,0 +1,214 @@
+//
+//  render.c
+//  TextAppMaker
+//
+
+#include "render.h"
+#include "grid.h"
+#include "map.h"
+#include "profile.h"
+#include "raster.h"
+#include "text.h"
+
+int backend = BACKEND_GEOMETRY;
+
+static const char * backend_names[NUM_BACKENDS] = {
+    [BACKEND_GEOMETRY] = "geometry",
+    [BACKEND_SOFTWARE] = "software",
+    [BACKEND_POINTS] = "points",
+};
+
+static SDL_Texture * texture;
+static int texture_w; // In pixels. May be larger than the view.
+static int texture_h;
+static int texture_backend;
+
+// Software backend framebuffer, and the band of pixel rows that has changed
+// since it was last uploaded.
+static u32 * framebuffer;
+static int dirty_top;
+static int dirty_bottom;
+
+void SetBackend(int new_backend)
+{
+    backend = new_backend;
+    UseGlyphAtlas(backend != BACKEND_POINTS);
+}
+
+const char * BackendName(int b)
+{
+    return backend_names[b];
+}
+
+int BackendFromName(const char * name)
+{
+    for ( int i = 0; i < NUM_BACKENDS; i++ ) {
+        if ( strcmp(name, backend_names[i]) == 0 ) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void FreeMapTexture(void)
+{
+    if ( texture ) {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+    }
+
+    free(framebuffer);
+    framebuffer = NULL;
+}
+
+void CreateMapTexture(int w, int h)
+{
+    FreeMapTexture();
+
+    texture_w = w * FONT_W;
+    texture_h = h * FONT_H;
+
+    if ( backend == BACKEND_SOFTWARE ) {
+        framebuffer = calloc(texture_w * texture_h, sizeof(*framebuffer));
+        texture = SDL_CreateTexture(renderer,
+                                    SDL_PIXELFORMAT_RGBA8888,
+                                    SDL_TEXTUREACCESS_STREAMING,
+                                    texture_w,
+                                    texture_h);
+
+        if ( framebuffer && texture ) {
+            dirty_top = texture_h;
+            dirty_bottom = 0;
+            texture_backend = backend;
+            return;
+        }
+
+        printf("Could not create software framebuffer (%s), using %s.\n",
+               SDL_GetError(),
+               backend_names[BACKEND_GEOMETRY]);
+        FreeMapTexture();
+        SetBackend(BACKEND_GEOMETRY);
+    }
+
+    texture = SDL_CreateTexture(renderer,
+                                SDL_PIXELFORMAT_RGBA8888,
+                                SDL_TEXTUREACCESS_TARGET,
+                                texture_w,
+                                texture_h);
+    texture_backend = backend;
+}
+
+void RebuildMapTexture(void)
+{
+    CreateMapTexture(view_w, view_h);
+    MarkDirtyRect((SDL_Rect){ view_x, view_y, view_w, view_h });
+}
+
+// Copy what was drawn in `old`, `old_w` x `old_h` pixels, to the top-left of
+// the current texture.
+static void CopyOldTexture(SDL_Texture * old, const u32 * old_framebuffer, int old_w, int old_h)
+{
+    int w = MIN(old_w, texture_w);
+    int h = MIN(old_h, texture_h);
+
+    if ( backend == BACKEND_SOFTWARE ) {
+        for ( int y = 0; y < h; y++ ) {
+            memcpy(&framebuffer[y * texture_w],
+                   &old_framebuffer[y * old_w],
+                   w * sizeof(*framebuffer));
+        }
+        dirty_top = 0;
+        dirty_bottom = h;
+    } else {
+        SDL_Rect r = { 0, 0, w, h };
+        SDL_SetTextureBlendMode(old, SDL_BLENDMODE_NONE);
+        SetRenderTarget(texture);
+        SDL_RenderCopy(renderer, old, &r, &r);
+        SetRenderTarget(NULL);
+    }
+}
+
+void ResizeMapTexture(void)
+{
+    int w = texture_w / FONT_W;
+    int h = texture_h / FONT_H;
+
+    if ( texture && backend == texture_backend && view_w <= w && view_h <= h ) {
+        return;
+    }
+
+    if ( texture == NULL || backend != texture_backend ) {
+        RebuildMapTexture();
+        return;
+    }
+
+    // Outgrown: take some room to grow into, and keep the contents, so only
+    // the newly exposed cells need drawing.
+    SDL_Texture * old = texture;
+    u32 * old_framebuffer = framebuffer;
+    int old_w = texture_w;
+    int old_h = texture_h;
+    int old_backend = texture_backend;
+    texture = NULL;
+    framebuffer = NULL;
+
+    CreateMapTexture(MIN(MAX(view_w, w * 2), MAX_VIEW_W),
+                     MIN(MAX(view_h, h * 2), MAX_VIEW_H));
+
+    if ( texture_backend == old_backend ) {
+        CopyOldTexture(old, old_framebuffer, old_w, old_h);
+    } else { // Fell back to another backend.
+        MarkDirtyRect((SDL_Rect){ view_x, view_y, view_w, view_h });
+    }
+
+    SDL_DestroyTexture(old);
+    free(old_framebuffer);
+}
+
+void DrawMapRegions(const u16 * cells, int pitch, const SDL_Rect * regions, int count)
+{
+    if ( count == 0 ) {
+        return;
+    }
+
+    if ( backend == BACKEND_SOFTWARE ) {
+        for ( int i = 0; i < count; i++ ) {
+            SDL_Rect r = regions[i];
+            RasterCells(framebuffer, texture_w, cells, pitch, r, r.x * FONT_W, r.y * FONT_H);
+            dirty_top = MIN(dirty_top, r.y * FONT_H);
+            dirty_bottom = MAX(dirty_bottom, (r.y + r.h) * FONT_H);
+        }
+        return;
+    }
+
+    SetRenderTarget(texture);
+    for ( int i = 0; i < count; i++ ) {
+        SDL_Rect r = regions[i];
+        RenderCells(cells, pitch, r, r.x * FONT_W, r.y * FONT_H);
+    }
+    SetRenderTarget(NULL);
+}
+
+void DrawMapCells(const u16 * cells, int pitch, SDL_Rect region)
+{
+    if ( region.w > 0 && region.h > 0 ) {
+        DrawMapRegions(cells, pitch, &region, 1);
+    }
+}
+
+void RenderMap(const SDL_Rect * dst)
+{
+    if ( backend == BACKEND_SOFTWARE && dirty_top < dirty_bottom ) {
+        SDL_Rect rows = { 0, dirty_top, texture_w, dirty_bottom - dirty_top };
+        SDL_UpdateTexture(texture,
+                          &rows,
+                          &framebuffer[dirty_top * texture_w],
+                          texture_w * sizeof(*framebuffer));
+        dirty_top = texture_h;
+        dirty_bottom = 0;
+    }
+
+    SDL_Rect src = { 0, 0, view_w * FONT_W, view_h * FONT_H };
+    SDL_RenderCopy(renderer, texture, &src, dst);
+}
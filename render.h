@@ -0,0 +1,53 @@
+//
+//  render.h
+//  TextAppMaker
+//
+//  The texture that holds the rendered work area, and the backends that can
+//  draw cells into it.
+//
+
+#ifndef render_h
+#define render_h
+
+#include "common.h"
+
+enum {
+    BACKEND_GEOMETRY, // Glyph atlas, batched into a render target texture.
+    BACKEND_SOFTWARE, // CPU framebuffer uploaded to a streaming texture.
+    BACKEND_POINTS,   // One SDL_RenderDrawPoint per lit pixel.
+    NUM_BACKENDS,
+};
+
+extern int backend;
+
+/// Takes effect at the next CreateMapTexture.
+void SetBackend(int new_backend);
+const char * BackendName(int b);
+
+/// Returns -1 if `name` is not a backend.
+int BackendFromName(const char * name);
+
+/// (Re)create the map texture for a `w` x `h` cell work area.
+void CreateMapTexture(int w, int h);
+void FreeMapTexture(void);
+
+/// (Re)create the map texture at the view size and mark the whole view to be
+/// redrawn into it.
+void RebuildMapTexture(void);
+
+/// Make sure the map texture can hold the view. It is only reallocated when
+/// the view outgrows it, with room to spare, or the backend has changed, and
+/// what it holds is kept where it can be.
+void ResizeMapTexture(void);
+
+/// Draw the cells in `region` of a `pitch`-wide cell array into the map
+/// texture at the same cell position.
+void DrawMapCells(const u16 * cells, int pitch, SDL_Rect region);
+
+/// Draw several regions with a single render target bind.
+void DrawMapRegions(const u16 * cells, int pitch, const SDL_Rect * regions, int count);
+
+/// Copy the map texture to the current render target.
+void RenderMap(const SDL_Rect * dst);
+
+#endif /* render_h */
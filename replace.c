@@ -0,0 +1,210 @@
+//
+//  replace.c
+//  TextAppMaker
+//
+
+#include "replace.h"
+#include "map.h"
+
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#define REPLACE_X86
+#endif
+
+typedef struct {
+    u16 find;       // Already masked
+    u16 find_mask;
+    u16 replace;    // Already masked
+    u16 keep_mask;  // ~replace_mask
+} pattern_t;
+
+// Write the replaced `in` to `out`, for up to CHUNK_SIZE cells. Returns a
+// bit per cell that changed.
+typedef u32 (* replace_t)(const u16 * in, u16 * out, int count, const pattern_t * p);
+static replace_t ReplaceSpan;
+
+static u32 ReplaceSpanScalar(const u16 * in, u16 * out, int count, const pattern_t * p)
+{
+    u32 changed = 0;
+
+    for ( int i = 0; i < count; i++ ) {
+        u16 cell = in[i];
+        if ( (cell & p->find_mask) == p->find ) {
+            cell = (cell & p->keep_mask) | p->replace;
+        }
+        out[i] = cell;
+        changed |= (u32)(cell != in[i]) << i;
+    }
+
+    return changed;
+}
+
+#ifdef REPLACE_X86
+#ifdef __SSE2__
+static u32 ReplaceSpanSSE2(const u16 * in, u16 * out, int count, const pattern_t * p)
+{
+    __m128i find = _mm_set1_epi16((short)p->find);
+    __m128i find_mask = _mm_set1_epi16((short)p->find_mask);
+    __m128i replace = _mm_set1_epi16((short)p->replace);
+    __m128i keep_mask = _mm_set1_epi16((short)p->keep_mask);
+    __m128i zero = _mm_setzero_si128();
+
+    u32 changed = 0;
+    int i = 0;
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m128i cells = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i match = _mm_cmpeq_epi16(_mm_and_si128(cells, find_mask), find);
+        __m128i new = _mm_or_si128(_mm_and_si128(cells, keep_mask), replace);
+        __m128i result = _mm_or_si128(_mm_and_si128(match, new),
+                                      _mm_andnot_si128(match, cells));
+        _mm_storeu_si128((__m128i *)(out + i), result);
+
+        // One byte per cell, set where unchanged.
+        __m128i same = _mm_packs_epi16(_mm_cmpeq_epi16(result, cells), zero);
+        changed |= (u32)(~_mm_movemask_epi8(same) & 0xFF) << i;
+    }
+
+    if ( i < count ) {
+        changed |= ReplaceSpanScalar(in + i, out + i, count - i, p) << i;
+    }
+
+    return changed;
+}
+#endif
+
+__attribute__((target("avx2")))
+static u32 ReplaceSpanAVX2(const u16 * in, u16 * out, int count, const pattern_t * p)
+{
+    __m256i find = _mm256_set1_epi16((short)p->find);
+    __m256i find_mask = _mm256_set1_epi16((short)p->find_mask);
+    __m256i replace = _mm256_set1_epi16((short)p->replace);
+    __m256i keep_mask = _mm256_set1_epi16((short)p->keep_mask);
+
+    u32 changed = 0;
+    int i = 0;
+    for ( ; i + 16 <= count; i += 16 ) {
+        __m256i cells = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i match = _mm256_cmpeq_epi16(_mm256_and_si256(cells, find_mask), find);
+        __m256i new = _mm256_or_si256(_mm256_and_si256(cells, keep_mask), replace);
+        __m256i result = _mm256_blendv_epi8(cells, new, match);
+        _mm256_storeu_si256((__m256i *)(out + i), result);
+
+        __m256i same = _mm256_cmpeq_epi16(result, cells);
+        __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(same),
+                                         _mm256_extracti128_si256(same, 1));
+        changed |= (u32)(~_mm_movemask_epi8(packed) & 0xFFFF) << i;
+    }
+
+    if ( i < count ) {
+        changed |= ReplaceSpanScalar(in + i, out + i, count - i, p) << i;
+    }
+
+    return changed;
+}
+#endif
+
+void InitReplace(void)
+{
+    if ( ReplaceSpan ) {
+        return;
+    }
+
+    ReplaceSpan = ReplaceSpanScalar;
+#ifdef REPLACE_X86
+#ifdef __SSE2__
+    ReplaceSpan = ReplaceSpanSSE2;
+#endif
+    if ( SDL_HasAVX2() ) {
+        ReplaceSpan = ReplaceSpanAVX2;
+    }
+#endif
+}
+
+SDL_Rect ReplaceCells(SDL_Rect area,
+                      u16 find,
+                      u16 find_mask,
+                      u16 replace,
+                      u16 replace_mask,
+                      int * count)
+{
+    InitReplace();
+
+    pattern_t p = {
+        find & find_mask,
+        find_mask,
+        replace & replace_mask,
+        ~replace_mask,
+    };
+
+    // Absent chunks are blank, so they only need looking at if blank cells
+    // match and would change.
+    static const u16 blank[CHUNK_SIZE];
+    u16 out[CHUNK_SIZE];
+    bool blank_changes = ReplaceSpanScalar(blank, out, 1, &p) != 0;
+
+    int x1 = MAX(area.x, 0);
+    int y1 = MAX(area.y, 0);
+    int x2 = MIN(area.x + area.w, app_w);
+    int y2 = MIN(area.y + area.h, app_h);
+
+    int changed_cells = 0;
+    int left = x2, right = x1 - 1, top = y2, bottom = y1 - 1;
+
+    // Walk a chunk at a time, which is far kinder to the cache than whole
+    // map rows.
+    for ( int cy = y1 & ~CHUNK_MASK; cy < y2; cy += CHUNK_SIZE ) {
+        int row1 = MAX(cy, y1);
+        int row2 = MIN(cy + CHUNK_SIZE, y2);
+
+        for ( int x = x1; x < x2; ) {
+            int n = MIN(x2 - x, CHUNK_SIZE - (x & CHUNK_MASK));
+            const chunk_t * chunk = chunks[cy >> CHUNK_SHIFT][x >> CHUNK_SHIFT];
+
+            if ( chunk == NULL && !blank_changes ) {
+                x += n;
+                continue;
+            }
+
+            for ( int y = row1; y < row2; y++ ) {
+                const u16 * in = blank;
+                if ( chunk ) {
+                    in = &chunk->cells[y & CHUNK_MASK][x & CHUNK_MASK];
+                }
+
+                u32 changed = ReplaceSpan(in, out, n, &p);
+                if ( changed == 0 ) {
+                    continue;
+                }
+
+                int first = __builtin_ctz(changed);
+                int last = 31 - __builtin_clz(changed);
+                WriteCells(x + first, y, last - first + 1, out + first);
+
+                // Writing blank cells may have allocated the chunk.
+                chunk = chunks[cy >> CHUNK_SHIFT][x >> CHUNK_SHIFT];
+
+                changed_cells += __builtin_popcount(changed);
+                left = MIN(left, x + first);
+                right = MAX(right, x + last);
+                top = MIN(top, y);
+                bottom = MAX(bottom, y);
+            }
+
+            x += n;
+        }
+    }
+
+    if ( count ) {
+        *count = changed_cells;
+    }
+
+    if ( changed_cells == 0 ) {
+        return (SDL_Rect){ 0, 0, 0, 0 };
+    }
+
+    SDL_Rect r = { left, top, right - left + 1, bottom - top + 1 };
+    MarkDirtyRect(r);
+    return r;
+}
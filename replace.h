@@ -0,0 +1,34 @@
+//
+//  replace.h
+//  TextAppMaker
+//
+//  Find and replace over the map. A cell matches when the bits selected by
+//  the find mask equal those of `find`; the bits selected by the replace
+//  mask are then taken from `replace`. Masks use the cell layout from
+//  common.h, so e.g. every blue background becomes black with
+//  find = bg 1, replace = bg 0, both masks CELL_BG.
+//
+
+#ifndef replace_h
+#define replace_h
+
+#include "common.h"
+
+#define CELL_CHAR 0x00FF
+#define CELL_FG   0x0F00
+#define CELL_BG   0xF000
+#define CELL_ALL  0xFFFF
+
+void InitReplace(void);
+
+/// Replace matching cells within `area` of the map. Marks the changed cells
+/// dirty and returns their bounding box. If `count` isn't NULL, it is set to
+/// the number of cells changed.
+SDL_Rect ReplaceCells(SDL_Rect area,
+                      u16 find,
+                      u16 find_mask,
+                      u16 replace,
+                      u16 replace_mask,
+                      int * count);
+
+#endif /* replace_h */
@@ -0,0 +1,129 @@
+//
+//  stroke.c
+//  TextAppMaker
+//
+
+#include "stroke.h"
+#include "undo.h"
+
+#include <stdlib.h>
+
+static bool stroking;
+static bool new_stroke; // The next paint starts a new undo step.
+static SDL_Point last; // The stroke's most recent cell
+
+// Cells waiting to be painted, in stroke order.
+static SDL_Point cells[MAX_STROKE_CELLS];
+static int num_cells;
+
+// Which cell, plus one, each slot was last gathered for, so a cell the stroke
+// crosses twice in a frame is gathered once. Any two cells in view go to
+// different slots.
+static u32 gathered[MAX_VIEW_H][MAX_VIEW_W];
+
+static void Gather(int x, int y)
+{
+    if ( x < view_x || x >= view_x + view_w || y < view_y || y >= view_y + view_h ) {
+        return;
+    }
+
+    u32 key = (u32)y * MAX_WIDTH + x + 1;
+    u32 * slot = &gathered[y % MAX_VIEW_H][x % MAX_VIEW_W];
+    if ( *slot == key || num_cells == MAX_STROKE_CELLS ) {
+        return;
+    }
+
+    *slot = key;
+    cells[num_cells++] = (SDL_Point){ x, y };
+}
+
+void BeginStroke(int x, int y)
+{
+    stroking = true;
+    new_stroke = true;
+    last = (SDL_Point){ x, y };
+    Gather(x, y);
+}
+
+// Bresenham's line from the last cell to x, y, without the last cell itself.
+void StrokeTo(int x, int y)
+{
+    if ( !stroking ) {
+        return;
+    }
+
+    int dx = abs(x - last.x);
+    int dy = -abs(y - last.y);
+    int sx = last.x < x ? 1 : -1;
+    int sy = last.y < y ? 1 : -1;
+    int error = dx + dy;
+
+    while ( last.x != x || last.y != y ) {
+        int e2 = error * 2;
+        if ( e2 >= dy ) {
+            error += dy;
+            last.x += sx;
+        }
+        if ( e2 <= dx ) {
+            error += dx;
+            last.y += sy;
+        }
+
+        Gather(last.x, last.y);
+    }
+}
+
+void EndStroke(void)
+{
+    stroking = false;
+}
+
+SDL_Rect PaintStroke(u8 ch, u8 fg, u8 bg)
+{
+    SDL_Rect box = { 0, 0, 0, 0 };
+    if ( num_cells == 0 ) {
+        return box;
+    }
+
+    int left = MAX_WIDTH;
+    int top = MAX_HEIGHT;
+    int right = -1;
+    int bottom = -1;
+
+    BeginEdit(EDIT_PAINT, !new_stroke);
+    for ( int i = 0; i < num_cells; i++ ) {
+        int x = cells[i].x;
+        int y = cells[i].y;
+        gathered[y % MAX_VIEW_H][x % MAX_VIEW_W] = 0;
+
+        // The work area shrank since.
+        if ( x >= app_w || y >= app_h ) {
+            continue;
+        }
+
+        u16 old = GetCell(x, y);
+        u16 cell = old;
+        SET_CHAR(cell, ch);
+        SET_FG(cell, fg);
+        SET_BG(cell, bg);
+
+        if ( cell != old ) {
+            SetCell(x, y, cell);
+            MarkDirty(x, y);
+            left = MIN(left, x);
+            top = MIN(top, y);
+            right = MAX(right, x);
+            bottom = MAX(bottom, y);
+        }
+    }
+    EndEdit();
+
+    num_cells = 0;
+    new_stroke = false;
+
+    if ( right >= left ) {
+        box = (SDL_Rect){ left, top, right - left + 1, bottom - top + 1 };
+    }
+
+    return box;
+}
@@ -0,0 +1,34 @@
+//
+//  stroke.h
+//  TextAppMaker
+//
+//  Paint strokes. The mouse positions of a stroke are joined with straight
+//  lines of cells, so moving fast leaves no gaps, and the cells gathered over
+//  a frame are painted together, each once, as one undo step per stroke.
+//
+
+#ifndef stroke_h
+#define stroke_h
+
+#include "map.h"
+#include <stdbool.h>
+
+// The most distinct cells a stroke can gather in one frame. The rest are
+// dropped.
+#define MAX_STROKE_CELLS (MAX_VIEW_W * MAX_VIEW_H * 4)
+
+/// Start a stroke at map cell x, y.
+void BeginStroke(int x, int y);
+
+/// Continue the stroke with a line to map cell x, y. Does nothing if there is
+/// no stroke.
+void StrokeTo(int x, int y);
+
+/// Finish the stroke. Cells not yet painted are kept for PaintStroke.
+void EndStroke(void);
+
+/// Paint the cells gathered since the last call that are in view. Marks the
+/// ones that changed dirty and returns the area they cover.
+SDL_Rect PaintStroke(u8 ch, u8 fg, u8 bg);
+
+#endif /* stroke_h */
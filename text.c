@@ -8,17 +8,98 @@
 #include "text.h"
 #include "common.h"
 #include "cp437.h"
+#include "profile.h"
 
 #define TEXT_SCALE 1.0f
 
-void PrintChar(int x, int y, unsigned char character)
+// All 256 glyphs, 16 per row, white on transparent. Tinted per draw with the
+// current render draw color.
+static SDL_Texture * glyph_atlas;
+static bool atlas_enabled = true;
+
+// Glyphs with no lit pixels (0, 32, 255...), which need no glyph quad.
+static bool glyph_blank[256];
+
+void InitText(void)
 {
-//    SDL_RenderSetScale(renderer, TEXT_SCALE, TEXT_SCALE);
+    const int atlas_w = 16 * FONT_W;
+    const int atlas_h = 16 * FONT_H;
 
-    // Scale drawing but not coordinates.
-    int unscaledX = (float)x / TEXT_SCALE;
-    int unscaledY = (float)y / TEXT_SCALE;
+    u32 * pixels = calloc(atlas_w * atlas_h, sizeof(*pixels));
+    if ( pixels == NULL ) {
+        return;
+    }
+
+    for ( int ch = 0; ch < 256; ch++ ) {
+        int gx = (ch % 16) * FONT_W;
+        int gy = (ch / 16) * FONT_H;
+        glyph_blank[ch] = true;
+
+        for ( int row = 0; row < FONT_H; row++ ) {
+            u8 bits = cp437[ch * FONT_H + row];
+            if ( bits ) {
+                glyph_blank[ch] = false;
+            }
+
+            u32 * dst = &pixels[(gy + row) * atlas_w + gx];
+
+            for ( int col = 0; col < FONT_W; col++ ) {
+                if ( bits & (0x80 >> col) ) {
+                    dst[col] = 0xFFFFFFFF;
+                }
+            }
+        }
+    }
+
+    glyph_atlas = SDL_CreateTexture(renderer,
+                                    SDL_PIXELFORMAT_RGBA8888,
+                                    SDL_TEXTUREACCESS_STATIC,
+                                    atlas_w,
+                                    atlas_h);
+
+    if ( glyph_atlas == NULL
+        || SDL_UpdateTexture(glyph_atlas, NULL, pixels, atlas_w * sizeof(*pixels)) )
+    {
+        printf("Could not create glyph atlas (%s), drawing text per pixel.\n",
+               SDL_GetError());
+        if ( glyph_atlas ) {
+            SDL_DestroyTexture(glyph_atlas);
+            glyph_atlas = NULL;
+        }
+    } else {
+        SDL_SetTextureBlendMode(glyph_atlas, SDL_BLENDMODE_BLEND);
+    }
+
+    free(pixels);
+}
+
+void FreeText(void)
+{
+    if ( glyph_atlas ) {
+        SDL_DestroyTexture(glyph_atlas);
+        glyph_atlas = NULL;
+    }
+}
 
+/// When disabled, text is drawn one point per pixel.
+void UseGlyphAtlas(bool use)
+{
+    atlas_enabled = use;
+}
+
+SDL_Texture * GlyphAtlas(void)
+{
+    return atlas_enabled ? glyph_atlas : NULL;
+}
+
+bool GlyphIsBlank(unsigned char character)
+{
+    return glyph_blank[character];
+}
+
+// Fallback: one point per lit pixel.
+static void PrintCharPoints(int x, int y, unsigned char character)
+{
     const int w = 8;
     const int h = 16;
 
@@ -30,7 +111,7 @@ void PrintChar(int x, int y, unsigned char character)
         for ( int col = 0; col < w; col++ )
         {
             if ( *data & (1 << bit) )
-                SDL_RenderDrawPoint(renderer, unscaledX + col, unscaledY + row);
+                SDL_RenderDrawPoint(renderer, x + col, y + row);
 
             if ( --bit < 8 - w )
             {
@@ -39,19 +120,60 @@ void PrintChar(int x, int y, unsigned char character)
             }
         }
     }
+}
+
+void PrintChar(int x, int y, unsigned char character)
+{
+    frame_counts[COUNT_PRINT_CHARS]++;
+
+//    SDL_RenderSetScale(renderer, TEXT_SCALE, TEXT_SCALE);
+
+    // Scale drawing but not coordinates.
+    int unscaledX = (float)x / TEXT_SCALE;
+    int unscaledY = (float)y / TEXT_SCALE;
+
+    if ( GlyphAtlas() == NULL ) {
+        PrintCharPoints(unscaledX, unscaledY, character);
+        return;
+    }
+
+    u8 r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_SetTextureColorMod(glyph_atlas, r, g, b);
+    SDL_SetTextureAlphaMod(glyph_atlas, a);
+
+    SDL_Rect src = {
+        (character % 16) * FONT_W,
+        (character / 16) * FONT_H,
+        FONT_W,
+        FONT_H
+    };
+    SDL_Rect dst = { unscaledX, unscaledY, FONT_W, FONT_H };
+    SDL_RenderCopy(renderer, glyph_atlas, &src, &dst);
 
 //    SDL_RenderSetScale(renderer, 1.0f, 1.0f);
 }
 
-// TODO: use a global or static buffer and only resize when needed.
 int PrintString(int x, int y, const char * format, ...)
 {
+    static char * buffer;
+    static int buffer_size;
+
     va_list args[2];
     va_start(args[0], format);
     va_copy(args[1], args[0]);
 
     int len = vsnprintf(NULL, 0, format, args[0]);
-    char * buffer = calloc(len + 1, sizeof(*buffer));
+    if ( len + 1 > buffer_size ) {
+        char * resized = realloc(buffer, len + 1);
+        if ( resized == NULL ) {
+            va_end(args[0]);
+            va_end(args[1]);
+            return x;
+        }
+        buffer = resized;
+        buffer_size = len + 1;
+    }
     vsnprintf(buffer, len + 1, format, args[1]);
     va_end(args[0]);
     va_end(args[1]);
@@ -82,6 +204,5 @@ int PrintString(int x, int y, const char * format, ...)
         c++;
     }
 
-    free(buffer);
     return x1;
 }
@@ -8,6 +8,14 @@
 #ifndef text_h
 #define text_h
 
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+void InitText(void);
+void FreeText(void);
+void UseGlyphAtlas(bool use);
+SDL_Texture * GlyphAtlas(void);
+bool GlyphIsBlank(unsigned char character);
 void PrintChar(int x, int y, unsigned char character);
 int PrintString(int x, int y, const char * format, ...);
 
@@ -0,0 +1,460 @@
+//
+//  tool.c
+//  TextAppMaker
+//
+//  Headless operations on screen files. Build with every .c file except
+//  main.c and bench.c and link SDL2, e.g.
+//  cc -O2 -o tool $(ls *.c | grep -v -e main.c -e bench.c) `sdl2-config --cflags --libs`
+//
+//  usage: tool replace FILE FIND REPLACE [OUT]
+//         tool export FILE OUT [ansi|cp437|text]
+//         tool import FILE.ans OUT
+//         tool play [--delay=MS] FILE...
+//         tool header [--ansi] DIR FILE...
+//         tool image [--scale=N] [--ppm] DIR FILE...
+//         tool convert [--width=N] IMAGE OUT
+//
+
+#include "common.h"
+#include "convert.h"
+#include "export.h"
+#include "image.h"
+#include "import.h"
+#include "file.h"
+#include "map.h"
+#include "player.h"
+#include "replace.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The file name in `path` without directory or extension. If `identifier`,
+// made into a C identifier.
+static void BaseName(const char * path, char * name, size_t size, bool identifier)
+{
+    const char * base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    size_t length = 0;
+    if ( identifier && isdigit((u8)base[0]) ) {
+        name[length++] = '_';
+    }
+    for ( const char * c = base; *c && *c != '.' && length < size - 1; c++ ) {
+        name[length++] = identifier && !isalnum((u8)*c) ? '_' : *c;
+    }
+    name[length] = '\0';
+}
+
+// Parse a cell pattern such as "ch=0xB0,bg=1" into a cell and a mask of the
+// fields it gives.
+static bool ParsePattern(const char * str, u16 * cell, u16 * mask)
+{
+    *cell = 0;
+    *mask = 0;
+
+    while ( *str ) {
+        char field[3] = { 0 };
+        int length = -1; // Not set unless the '=' matched too.
+        if ( sscanf(str, "%2[a-z]=%n", field, &length) != 1 || length < 0 ) {
+            printf("Bad pattern '%s'\n", str);
+            return false;
+        }
+        str += length;
+
+        char * end;
+        long value = strtol(str, &end, 0);
+        if ( end == str ) {
+            printf("Missing value for '%s'\n", field);
+            return false;
+        }
+        str = *end == ',' ? end + 1 : end;
+
+        if ( strcmp(field, "ch") == 0 && value >= 0 && value <= 255 ) {
+            SET_CHAR(*cell, (u16)value);
+            *mask |= CELL_CHAR;
+        } else if ( strcmp(field, "fg") == 0 && value >= 0 && value <= 15 ) {
+            SET_FG(*cell, (u16)value);
+            *mask |= CELL_FG;
+        } else if ( strcmp(field, "bg") == 0 && value >= 0 && value <= 15 ) {
+            SET_BG(*cell, (u16)value);
+            *mask |= CELL_BG;
+        } else {
+            printf("Bad field '%s=%ld'\n", field, value);
+            return false;
+        }
+    }
+
+    if ( *mask == 0 ) {
+        printf("Empty pattern\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Replace matching cells across the whole screen, e.g.
+// tool replace title.tam bg=1 bg=0
+static int Replace(int argc, char ** argv)
+{
+    const char * in_path = argv[2];
+    const char * out_path = argc >= 6 ? argv[5] : in_path;
+
+    u16 find, find_mask, replace, replace_mask;
+    if ( !ParsePattern(argv[3], &find, &find_mask)
+        || !ParsePattern(argv[4], &replace, &replace_mask)
+        || !LoadFile(in_path) )
+    {
+        return 1;
+    }
+
+    int count;
+    SDL_Rect r = ReplaceCells((SDL_Rect){ 0, 0, app_w, app_h },
+                              find,
+                              find_mask,
+                              replace,
+                              replace_mask,
+                              &count);
+
+    printf("Replaced %d cells in %d x %d at %d, %d\n", count, r.w, r.h, r.x, r.y);
+
+    return SaveFile(out_path) ? 0 : 1;
+}
+
+// Write a screen as ANSI (the default) or text.
+static int Export(int argc, char ** argv)
+{
+    static const char * names[] = { "text", "ansi", "cp437" };
+    static const int formats[] = { EXPORT_TEXT, EXPORT_ANSI, EXPORT_ANSI_CP437 };
+
+    int format = EXPORT_ANSI;
+    if ( argc >= 5 ) {
+        format = -1;
+        for ( int i = 0; i < 3; i++ ) {
+            if ( strcmp(argv[4], names[i]) == 0 ) {
+                format = formats[i];
+            }
+        }
+
+        if ( format == -1 ) {
+            printf("Unknown export format '%s'\n", argv[4]);
+            return 1;
+        }
+    }
+
+    if ( !LoadFile(argv[2]) ) {
+        return 1;
+    }
+
+    return ExportFile(argv[3], format) ? 0 : 1;
+}
+
+// Convert ANSI art to a screen file.
+static int Import(char ** argv)
+{
+    sauce_t sauce;
+    if ( !ImportANSI(argv[2], &sauce) ) {
+        return 1;
+    }
+
+    printf("Imported %d x %d", app_w, app_h);
+    if ( sauce.title[0] ) {
+        printf(", '%s' by %s", sauce.title, sauce.author[0] ? sauce.author : "unknown");
+    }
+    printf("\n");
+
+    return SaveFile(argv[3]) ? 0 : 1;
+}
+
+// Show screens in this terminal one after another, each after Enter is
+// pressed or the delay has passed. Only what changed is redrawn.
+static int Play(int argc, char ** argv)
+{
+    int delay = -1;
+    int first = 2;
+    if ( strncmp(argv[2], "--delay=", 8) == 0 ) {
+        delay = atoi(argv[2] + 8);
+        first++;
+    }
+
+    player_t player;
+    InitPlayer(&player, stdout);
+    u16 * frame = NULL;
+    size_t total_bytes = 0;
+    int failures = 0;
+
+    printf("\x1b[?25l"); // Hide the cursor.
+
+    for ( int i = first; i < argc; i++ ) {
+        if ( !LoadFile(argv[i]) ) {
+            failures++;
+            continue;
+        }
+
+        u16 * new_frame = realloc(frame, (size_t)app_w * app_h * sizeof(*frame));
+        if ( new_frame == NULL ) {
+            failures++;
+            break;
+        }
+        frame = new_frame;
+
+        for ( int y = 0; y < app_h; y++ ) {
+            ReadCells(0, y, app_w, &frame[y * app_w]);
+        }
+
+        if ( !PresentFrame(&player, frame, app_w, app_w, app_h) ) {
+            failures++;
+            break;
+        }
+        total_bytes += player.frame_bytes;
+
+        if ( delay >= 0 ) {
+            SDL_Delay(delay);
+        } else if ( i + 1 < argc ) {
+            int c;
+            while ( (c = getchar()) != '\n' && c != EOF ) { }
+        }
+    }
+
+    printf("\x1b[0m\x1b[?25h\n");
+    fprintf(stderr, "%d screens, %zu bytes\n", argc - first, total_bytes);
+
+    free(frame);
+    FreePlayer(&player);
+    return failures != 0;
+}
+
+// Write each screen as DIR/NAME.h, where NAME is the file's name without
+// its extension, made into a C identifier.
+static int Header(int argc, char ** argv)
+{
+    bool ansi = false;
+    int first = 2;
+    if ( strcmp(argv[2], "--ansi") == 0 ) {
+        ansi = true;
+        first++;
+    }
+
+    if ( first + 1 >= argc ) {
+        printf("No screen files given\n");
+        return 1;
+    }
+
+    const char * dir = argv[first++];
+    int failures = 0;
+
+    for ( int i = first; i < argc; i++ ) {
+        char name[256];
+        BaseName(argv[i], name, sizeof(name), true);
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s.h", dir, name);
+
+        if ( !LoadFile(argv[i]) || !ExportHeader(path, name, ansi) ) {
+            failures++;
+            continue;
+        }
+
+        printf("%s -> %s\n", argv[i], path);
+    }
+
+    return failures != 0;
+}
+
+typedef struct {
+    char path[1024];
+    u16 * cells;
+    int w;
+    int h;
+    int format;
+    int scale;
+    bool ok;
+} image_job_t;
+
+static int RunImageJob(void * data)
+{
+    image_job_t * job = data;
+    job->ok = WriteImage(job->path, job->format, job->cells, job->w, job->h, job->scale, 1);
+    return 0;
+}
+
+// Render each screen to DIR/NAME.png (or .ppm). A single screen is split
+// across every CPU; several are rendered that many at a time instead, as
+// the map only holds one screen at a time.
+static int Image(int argc, char ** argv)
+{
+    int format = IMAGE_PNG;
+    int scale = 1;
+    int first = 2;
+
+    for ( ; first < argc && strncmp(argv[first], "--", 2) == 0; first++ ) {
+        if ( strncmp(argv[first], "--scale=", 8) == 0 ) {
+            scale = atoi(argv[first] + 8);
+        } else if ( strcmp(argv[first], "--ppm") == 0 ) {
+            format = IMAGE_PPM;
+        } else {
+            printf("Unknown option '%s'\n", argv[first]);
+            return 1;
+        }
+    }
+
+    if ( scale < 1 || scale > MAX_IMAGE_SCALE ) {
+        printf("Scale must be 1 to %d\n", MAX_IMAGE_SCALE);
+        return 1;
+    }
+
+    if ( first + 1 >= argc ) {
+        printf("No screen files given\n");
+        return 1;
+    }
+
+    const char * dir = argv[first++];
+    const char * extension = format == IMAGE_PNG ? "png" : "ppm";
+    int num_files = argc - first;
+    int cpus = MAX(SDL_GetCPUCount(), 1);
+    int batch = MIN(num_files, cpus);
+
+    image_job_t * jobs = calloc(batch, sizeof(*jobs));
+    SDL_Thread ** threads = calloc(batch, sizeof(*threads));
+    if ( jobs == NULL || threads == NULL ) {
+        printf("Out of memory\n");
+        free(jobs);
+        free(threads);
+        return 1;
+    }
+
+    int failures = 0;
+    u64 start = SDL_GetPerformanceCounter();
+
+    for ( int i = 0; i < num_files; i += batch ) {
+        int n = MIN(batch, num_files - i);
+
+        // Loading uses the map, so it stays on this thread.
+        for ( int j = 0; j < n; j++ ) {
+            image_job_t * job = &jobs[j];
+            job->ok = false;
+
+            char name[256];
+            BaseName(argv[first + i + j], name, sizeof(name), false);
+            snprintf(job->path, sizeof(job->path), "%s/%s.%s", dir, name, extension);
+
+            if ( !LoadFile(argv[first + i + j]) ) {
+                job->w = 0;
+                continue;
+            }
+
+            u16 * cells = realloc(job->cells, (size_t)app_w * app_h * sizeof(*cells));
+            if ( cells == NULL ) {
+                job->w = 0;
+                continue;
+            }
+
+            job->cells = cells;
+            job->w = app_w;
+            job->h = app_h;
+            job->format = format;
+            job->scale = scale;
+            for ( int y = 0; y < app_h; y++ ) {
+                ReadCells(0, y, app_w, &cells[y * app_w]);
+            }
+        }
+
+        if ( n == 1 && jobs[0].w ) {
+            jobs[0].ok = WriteImage(jobs[0].path, format, jobs[0].cells, jobs[0].w, jobs[0].h, scale, cpus);
+        } else {
+            for ( int j = 0; j < n; j++ ) {
+                threads[j] = NULL;
+                if ( jobs[j].w ) {
+                    threads[j] = SDL_CreateThread(RunImageJob, "image", &jobs[j]);
+                    if ( threads[j] == NULL ) {
+                        RunImageJob(&jobs[j]);
+                    }
+                }
+            }
+
+            for ( int j = 0; j < n; j++ ) {
+                if ( threads[j] ) {
+                    SDL_WaitThread(threads[j], NULL);
+                }
+            }
+        }
+
+        for ( int j = 0; j < n; j++ ) {
+            failures += !jobs[j].ok;
+        }
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start)
+        / SDL_GetPerformanceFrequency();
+    printf("%d images in %.1f ms\n", num_files - failures, seconds * 1000.0);
+
+    for ( int j = 0; j < batch; j++ ) {
+        free(jobs[j].cells);
+    }
+    free(jobs);
+    free(threads);
+
+    return failures != 0;
+}
+
+// Turn a picture into a screen file.
+static int Convert(int argc, char ** argv)
+{
+    int width = 0;
+    int first = 2;
+    if ( strncmp(argv[first], "--width=", 8) == 0 ) {
+        width = atoi(argv[first++] + 8);
+        if ( width < 1 || width > MAX_WIDTH ) {
+            printf("Width must be 1 to %d\n", MAX_WIDTH);
+            return 1;
+        }
+    }
+
+    if ( first + 1 >= argc ) {
+        printf("No output file given\n");
+        return 1;
+    }
+
+    u64 start = SDL_GetPerformanceCounter();
+    if ( !ConvertImage(argv[first], width) ) {
+        return 1;
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start)
+        / SDL_GetPerformanceFrequency();
+    printf("Converted to %d x %d in %.1f ms\n", app_w, app_h, seconds * 1000.0);
+
+    return SaveFile(argv[first + 1]) ? 0 : 1;
+}
+
+int main(int argc, char ** argv)
+{
+    if ( argc >= 5 && strcmp(argv[1], "replace") == 0 ) {
+        return Replace(argc, argv);
+    } else if ( argc >= 4 && strcmp(argv[1], "export") == 0 ) {
+        return Export(argc, argv);
+    } else if ( argc >= 4 && strcmp(argv[1], "import") == 0 ) {
+        return Import(argv);
+    } else if ( argc >= 3 && strcmp(argv[1], "play") == 0 ) {
+        return Play(argc, argv);
+    } else if ( argc >= 4 && strcmp(argv[1], "header") == 0 ) {
+        return Header(argc, argv);
+    } else if ( argc >= 4 && strcmp(argv[1], "image") == 0 ) {
+        return Image(argc, argv);
+    } else if ( argc >= 4 && strcmp(argv[1], "convert") == 0 ) {
+        return Convert(argc, argv);
+    }
+
+    printf("usage: %s replace FILE FIND REPLACE [OUT]\n", argv[0]);
+    printf("       %s export FILE OUT [ansi|cp437|text]\n", argv[0]);
+    printf("       %s import FILE.ans OUT\n", argv[0]);
+    printf("       %s play [--delay=MS] FILE...\n", argv[0]);
+    printf("       %s header [--ansi] DIR FILE...\n", argv[0]);
+    printf("       %s image [--scale=N] [--ppm] DIR FILE...\n", argv[0]);
+    printf("       %s convert [--width=N] IMAGE OUT\n", argv[0]);
+    printf("  images to convert are BMP or binary PPM\n");
+    printf("  patterns are fields ch=N, fg=N, bg=N separated by commas\n");
+    return 1;
+}
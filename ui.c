@@ -0,0 +1,114 @@
+//
+//  ui.c
+//  TextAppMaker
+//
+
+#include "ui.h"
+#include "grid.h"
+#include "profile.h"
+
+static SDL_Texture * hatching;
+static int hatching_w;
+static int hatching_h;
+
+static SDL_Texture * char_palette;
+static int char_palette_fg = -1;
+static int char_palette_bg = -1;
+
+static SDL_Texture * CreateLayer(int w, int h)
+{
+    SDL_Texture * layer = SDL_CreateTexture(renderer,
+                                            SDL_PIXELFORMAT_RGBA8888,
+                                            SDL_TEXTUREACCESS_TARGET,
+                                            w,
+                                            h);
+    if ( layer ) {
+        SDL_SetTextureBlendMode(layer, SDL_BLENDMODE_NONE);
+    }
+
+    return layer;
+}
+
+static void DrawHatching(int w, int h)
+{
+    SDL_SetRenderDrawColor(renderer, 16, 16, 16, 255);
+    SDL_RenderClear(renderer);
+
+    SDL_SetRenderDrawColor(renderer, 32, 32, 32, 255);
+    for ( int x = FONT_W; x < w + h; x += FONT_W ) {
+        SDL_RenderDrawLine(renderer, x, 0, 0, x * 2);
+    }
+}
+
+void RenderHatching(int w, int h)
+{
+    if ( hatching == NULL || w != hatching_w || h != hatching_h ) {
+        if ( hatching ) {
+            SDL_DestroyTexture(hatching);
+        }
+
+        hatching = CreateLayer(w, h);
+        hatching_w = w;
+        hatching_h = h;
+
+        if ( hatching == NULL ) {
+            DrawHatching(w, h);
+            return;
+        }
+
+        SetRenderTarget(hatching);
+        DrawHatching(w, h);
+        SetRenderTarget(NULL);
+    }
+
+    SDL_Rect dst = { 0, 0, w, h };
+    SDL_RenderCopy(renderer, hatching, NULL, &dst);
+}
+
+static void DrawCharPalette(int x, int y, u8 fg, u8 bg)
+{
+    u16 cells[256];
+    for ( int i = 0; i < 256; i++ ) {
+        cells[i] = bg << 12 | fg << 8 | i;
+    }
+
+    SDL_Rect all = { 0, 0, 16, 16 };
+    RenderCells(cells, 16, all, x, y);
+}
+
+void RenderCharPalette(int x, int y, u8 fg, u8 bg)
+{
+    if ( char_palette == NULL ) {
+        char_palette = CreateLayer(16 * FONT_W, 16 * FONT_H);
+        if ( char_palette == NULL ) {
+            DrawCharPalette(x, y, fg, bg);
+            return;
+        }
+    }
+
+    if ( fg != char_palette_fg || bg != char_palette_bg ) {
+        SetRenderTarget(char_palette);
+        DrawCharPalette(0, 0, fg, bg);
+        SetRenderTarget(NULL);
+        char_palette_fg = fg;
+        char_palette_bg = bg;
+    }
+
+    SDL_Rect dst = { x, y, 16 * FONT_W, 16 * FONT_H };
+    SDL_RenderCopy(renderer, char_palette, NULL, &dst);
+}
+
+void FreeUI(void)
+{
+    if ( hatching ) {
+        SDL_DestroyTexture(hatching);
+        hatching = NULL;
+    }
+
+    if ( char_palette ) {
+        SDL_DestroyTexture(char_palette);
+        char_palette = NULL;
+        char_palette_fg = -1;
+        char_palette_bg = -1;
+    }
+}
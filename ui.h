@@ -0,0 +1,23 @@
+//
+//  ui.h
+//  TextAppMaker
+//
+//  Parts of the window that rarely change, cached in textures and only
+//  redrawn when what they depend on changes.
+//
+
+#ifndef ui_h
+#define ui_h
+
+#include "common.h"
+
+/// Window background with diagonal hatching. Rebuilt when the size changes.
+void RenderHatching(int w, int h);
+
+/// The 16 x 16 character palette at pixel x, y. Rebuilt when the colors
+/// change.
+void RenderCharPalette(int x, int y, u8 fg, u8 bg);
+
+void FreeUI(void);
+
+#endif /* ui_h */
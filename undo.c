@@ -0,0 +1,242 @@
+//
+//  undo.c
+//  TextAppMaker
+//
+
+#include "undo.h"
+#include "map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    u16 x;
+    u16 y;
+    u16 count;
+    u16 old;
+    u16 new;
+} run_t;
+
+typedef struct {
+    int kind;
+    int first_run;
+    int num_runs;
+} edit_t;
+
+size_t undo_budget = 16 * 1024 * 1024;
+bool recording;
+
+// The arena of runs, and the edits that own them, oldest first. Edits before
+// `current` can be undone, the rest redone.
+static run_t * runs;
+static int num_runs;
+static int runs_capacity;
+
+static edit_t * edits;
+static int num_edits;
+static int edits_capacity;
+static int current;
+
+// Set when the open edit outgrew the budget on its own. It is dropped.
+static bool overflowed;
+
+static size_t JournalSize(void)
+{
+    return num_runs * sizeof(*runs) + num_edits * sizeof(*edits);
+}
+
+// Drop the oldest edits until the journal fits in `budget`, keeping the
+// newest `keep` edits.
+static void Evict(size_t budget, int keep)
+{
+    int drop = 0;
+    int dropped_runs = 0;
+
+    while ( drop < num_edits - keep
+           && JournalSize() - dropped_runs * sizeof(*runs) - drop * sizeof(*edits) > budget )
+    {
+        dropped_runs += edits[drop].num_runs;
+        drop++;
+    }
+
+    if ( drop == 0 ) {
+        return;
+    }
+
+    memmove(runs, runs + dropped_runs, (num_runs - dropped_runs) * sizeof(*runs));
+    memmove(edits, edits + drop, (num_edits - drop) * sizeof(*edits));
+    num_runs -= dropped_runs;
+    num_edits -= drop;
+    current -= drop;
+
+    for ( int i = 0; i < num_edits; i++ ) {
+        edits[i].first_run -= dropped_runs;
+    }
+}
+
+void BeginEdit(int kind, bool coalesce)
+{
+    // Anything undone is lost once something new is done.
+    if ( current < num_edits ) {
+        num_runs = edits[current].first_run;
+        num_edits = current;
+        coalesce = false;
+    }
+
+    recording = true;
+    overflowed = false;
+
+    if ( coalesce && num_edits > 0 && edits[num_edits - 1].kind == kind ) {
+        return; // Keep appending to the last edit.
+    }
+
+    if ( num_edits == edits_capacity ) {
+        int max_capacity = (int)(undo_budget / sizeof(*edits));
+        if ( edits_capacity >= max_capacity ) {
+            // A budget's worth of edits: drop the oldest rather than grow.
+            Evict(JournalSize() - sizeof(*edits), 0);
+        } else {
+            int new_capacity = MIN(edits_capacity ? edits_capacity * 2 : 64, max_capacity);
+            edit_t * new_edits = realloc(edits, new_capacity * sizeof(*edits));
+            if ( new_edits ) {
+                edits = new_edits;
+                edits_capacity = new_capacity;
+            }
+        }
+
+        if ( num_edits == edits_capacity ) {
+            recording = false;
+            return;
+        }
+    }
+
+    edits[num_edits++] = (edit_t){ kind, num_runs, 0 };
+    current = num_edits;
+}
+
+void EndEdit(void)
+{
+    if ( !recording ) {
+        return;
+    }
+
+    recording = false;
+    edit_t * edit = &edits[num_edits - 1];
+
+    if ( overflowed || edit->num_runs == 0 ) {
+        num_runs = edit->first_run;
+        current = --num_edits;
+        if ( overflowed ) {
+            printf("Edit too large to undo, history cleared\n");
+            ClearUndo();
+        }
+        return;
+    }
+
+    if ( JournalSize() > undo_budget ) {
+        Evict(undo_budget, 1);
+    }
+}
+
+void RecordCell(int x, int y, u16 old, u16 new)
+{
+    if ( !recording || overflowed ) {
+        return;
+    }
+
+    edit_t * edit = &edits[num_edits - 1];
+
+    if ( edit->num_runs > 0 ) {
+        run_t * last = &runs[num_runs - 1];
+        if ( last->y == y
+            && last->x + last->count == x
+            && last->old == old
+            && last->new == new
+            && last->count < UINT16_MAX )
+        {
+            last->count++;
+            return;
+        }
+    }
+
+    if ( num_runs == runs_capacity ) {
+        // Make room by dropping old edits rather than growing past the
+        // budget. If the open edit alone doesn't fit, give up on it.
+        if ( runs_capacity * 2 * sizeof(*runs) > undo_budget ) {
+            Evict(undo_budget / 2, 1);
+            edit = &edits[num_edits - 1];
+        }
+
+        if ( edit->num_runs * sizeof(*runs) >= undo_budget ) {
+            overflowed = true;
+            return;
+        }
+
+        if ( num_runs == runs_capacity ) {
+            int max_capacity = (int)(undo_budget / sizeof(*runs));
+            int new_capacity = MIN(runs_capacity ? runs_capacity * 2 : 4096, max_capacity);
+            if ( new_capacity <= runs_capacity ) {
+                overflowed = true;
+                return;
+            }
+
+            run_t * new_runs = realloc(runs, new_capacity * sizeof(*runs));
+            if ( new_runs == NULL ) {
+                overflowed = true;
+                return;
+            }
+            runs = new_runs;
+            runs_capacity = new_capacity;
+        }
+    }
+
+    runs[num_runs++] = (run_t){ x, y, 1, old, new };
+    edit->num_runs++;
+}
+
+static void ApplyRun(const run_t * run, u16 cell)
+{
+    for ( int i = 0; i < run->count; i++ ) {
+        SetCell(run->x + i, run->y, cell);
+    }
+
+    MarkDirtyRect((SDL_Rect){ run->x, run->y, run->count, 1 });
+}
+
+bool Undo(void)
+{
+    if ( recording || current == 0 ) {
+        return false;
+    }
+
+    const edit_t * edit = &edits[--current];
+    for ( int i = edit->num_runs - 1; i >= 0; i-- ) {
+        const run_t * run = &runs[edit->first_run + i];
+        ApplyRun(run, run->old);
+    }
+
+    return true;
+}
+
+bool Redo(void)
+{
+    if ( recording || current == num_edits ) {
+        return false;
+    }
+
+    const edit_t * edit = &edits[current++];
+    for ( int i = 0; i < edit->num_runs; i++ ) {
+        const run_t * run = &runs[edit->first_run + i];
+        ApplyRun(run, run->new);
+    }
+
+    return true;
+}
+
+void ClearUndo(void)
+{
+    num_runs = 0;
+    num_edits = 0;
+    current = 0;
+}
@@ -0,0 +1,48 @@
+//
+//  undo.h
+//  TextAppMaker
+//
+//  Undo history. While an edit is open, every cell the map changes is
+//  recorded as a run of (position, old cell, new cell). Consecutive cells in
+//  a row with the same old and new values share one run, so filling a blank
+//  area costs a run per row rather than a copy of the map.
+//
+
+#ifndef undo_h
+#define undo_h
+
+#include "common.h"
+#include <stdbool.h>
+
+enum {
+    EDIT_PAINT,
+    EDIT_TEXT,
+    EDIT_FILL,
+    EDIT_PASTE,
+    EDIT_CLEAR,
+};
+
+// Oldest history is dropped to keep the journal under this many bytes.
+extern size_t undo_budget;
+
+// True while an edit is open.
+extern bool recording;
+
+/// Start recording an edit. If `coalesce` is set and the last edit was of the
+/// same kind and nothing has been undone since, the changes are added to it
+/// instead, so e.g. a paint stroke undoes as one step.
+void BeginEdit(int kind, bool coalesce);
+void EndEdit(void);
+
+/// Called by the map for every cell that changes.
+void RecordCell(int x, int y, u16 old, u16 new);
+
+/// Return false if there is nothing to undo or redo. Changed cells are marked
+/// dirty.
+bool Undo(void);
+bool Redo(void);
+
+/// Forget all history, e.g. after loading a file.
+void ClearUndo(void);
+
+#endif /* undo_h */
@@ -0,0 +1,200 @@
+//
+//  worker.c
+//  TextAppMaker
+//
+
+#include "worker.h"
+#include "fill.h"
+#include "replace.h"
+#include "block.h"
+#include "undo.h"
+#include "file.h"
+#include "export.h"
+#include "image.h"
+
+#include <stdio.h>
+
+static SDL_Thread * thread;
+static SDL_sem * queued; // Posted per task pushed
+static SDL_sem * idle;   // Posted when the ring empties
+
+// The main thread only writes head and the worker only tail. A task stays in
+// the ring, counted as busy, until it has run.
+static task_t tasks[MAX_TASKS];
+static SDL_atomic_t head;
+static SDL_atomic_t tail;
+
+static void RunTask(const task_t * task)
+{
+    switch ( task->kind ) {
+        case TASK_FILL:
+            BeginEdit(EDIT_FILL, false);
+            FloodFill(task->fill.x,
+                      task->fill.y,
+                      task->fill.cell,
+                      task->fill.match,
+                      task->fill.diagonal);
+            EndEdit();
+            break;
+
+        case TASK_REPLACE: {
+            int count;
+            BeginEdit(EDIT_FILL, false);
+            ReplaceCells(task->replace.area,
+                         task->replace.find,
+                         task->replace.mask,
+                         task->replace.brush,
+                         task->replace.mask,
+                         &count);
+            EndEdit();
+            printf("Replaced %d cells\n", count);
+            break;
+        }
+
+        case TASK_RECOLOR:
+            BeginEdit(EDIT_FILL, false);
+            RecolorBlock(task->recolor.area, task->recolor.fg, task->recolor.bg);
+            EndEdit();
+            break;
+
+        case TASK_CLEAR:
+            BeginEdit(EDIT_CLEAR, false);
+            FillBlock(task->clear.area, task->clear.blank);
+            EndEdit();
+            break;
+
+        case TASK_PASTE:
+            BeginEdit(EDIT_PASTE, false);
+            PasteBlock(task->paste.block, task->paste.x, task->paste.y);
+            EndEdit();
+            break;
+
+        case TASK_MOVE:
+            BeginEdit(EDIT_PASTE, false);
+            MoveBlock(task->move.area, task->move.dx, task->move.dy, 0);
+            EndEdit();
+            break;
+
+        case TASK_UNDO:
+            Undo();
+            break;
+
+        case TASK_REDO:
+            Redo();
+            break;
+
+        case TASK_SAVE:
+            if ( SaveFile(task->file.path) ) {
+                printf("Saved '%s'\n", task->file.path);
+            }
+            break;
+
+        case TASK_EXPORT:
+            if ( ExportFile(task->file.path, task->file.format) ) {
+                printf("Exported '%s'\n", task->file.path);
+            }
+            break;
+
+        case TASK_IMAGE:
+            if ( ExportImage(task->file.path, task->file.format, 1) ) {
+                printf("Exported '%s'\n", task->file.path);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static int WorkerThread(void * data)
+{
+    (void)data;
+
+    for ( ;; ) {
+        SDL_SemWait(queued);
+
+        int index = SDL_AtomicGet(&tail);
+        SDL_MemoryBarrierAcquire();
+        const task_t * task = &tasks[index % MAX_TASKS];
+        int kind = task->kind;
+        RunTask(task);
+
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&tail, index + 1);
+        if ( index + 1 == SDL_AtomicGet(&head) ) {
+            SDL_SemPost(idle);
+        }
+
+        if ( kind == TASK_QUIT ) {
+            return 0;
+        }
+    }
+}
+
+bool StartWorker(void)
+{
+    queued = SDL_CreateSemaphore(0);
+    idle = SDL_CreateSemaphore(0);
+    thread = SDL_CreateThread(WorkerThread, "worker", NULL);
+
+    if ( queued == NULL || idle == NULL || thread == NULL ) {
+        printf("Failed to start the worker thread: %s\n", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+void StopWorker(void)
+{
+    if ( thread == NULL ) {
+        return;
+    }
+
+    PushTask(&(task_t){ .kind = TASK_QUIT });
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+
+    SDL_DestroySemaphore(queued);
+    SDL_DestroySemaphore(idle);
+}
+
+void PushTask(const task_t * task)
+{
+    // Drop a post left from when the ring last emptied, so waits are for this
+    // task and not already over.
+    if ( !WorkerBusy() ) {
+        while ( SDL_SemTryWait(idle) == 0 ) { }
+    }
+
+    int index = SDL_AtomicGet(&head);
+    while ( index - SDL_AtomicGet(&tail) == MAX_TASKS ) {
+        SDL_Delay(1);
+    }
+
+    SDL_MemoryBarrierAcquire();
+    tasks[index % MAX_TASKS] = *task;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&head, index + 1);
+    SDL_SemPost(queued);
+}
+
+bool WorkerBusy(void)
+{
+    bool busy = SDL_AtomicGet(&tail) != SDL_AtomicGet(&head);
+    SDL_MemoryBarrierAcquire();
+    return busy;
+}
+
+void WaitForWorker(int timeout)
+{
+    // A post can still slip in between PushTask's drain and the worker
+    // finishing the previous task, so check again after each one.
+    u32 deadline = SDL_GetTicks() + timeout;
+    while ( WorkerBusy() ) {
+        int left = (int)(deadline - SDL_GetTicks());
+        if ( left <= 0 || SDL_SemWaitTimeout(idle, left) != 0 ) {
+            break;
+        }
+    }
+}
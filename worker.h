@@ -0,0 +1,65 @@
+//
+//  worker.h
+//  TextAppMaker
+//
+//  Edits that can take a while, run on a worker thread so the window keeps
+//  drawing. Tasks go from the main thread to the worker over a single-producer,
+//  single-consumer ring. While any are queued or running the worker owns the
+//  map, its dirty cells and the undo history: the main thread must not touch
+//  them until WorkerBusy returns false.
+//
+
+#ifndef worker_h
+#define worker_h
+
+#include "block.h"
+#include "common.h"
+#include <stdbool.h>
+
+#define MAX_TASKS 16 // Queued at once. A power of two.
+
+enum {
+    TASK_FILL,
+    TASK_REPLACE,
+    TASK_RECOLOR,
+    TASK_CLEAR,
+    TASK_PASTE,
+    TASK_MOVE,
+    TASK_UNDO,
+    TASK_REDO,
+    TASK_SAVE,
+    TASK_EXPORT,
+    TASK_IMAGE,
+    TASK_QUIT,
+};
+
+typedef struct {
+    int kind;
+    union {
+        struct { int x, y; u16 cell; int match; bool diagonal; } fill;
+        struct { SDL_Rect area; u16 find, mask, brush; } replace;
+        struct { SDL_Rect area; int fg, bg; } recolor;
+        struct { SDL_Rect area; u16 blank; } clear;
+        struct { const block_t * block; int x, y; } paste; // Unchanged until run
+        struct { SDL_Rect area; int dx, dy; } move;
+        struct { char path[1024]; int format; } file; // Save, export, image
+    };
+} task_t;
+
+/// Prints why and returns false on failure.
+bool StartWorker(void);
+
+/// Finish the queued tasks and stop the thread.
+void StopWorker(void);
+
+/// Queue a copy of `task`, waiting for room if the ring is full.
+void PushTask(const task_t * task);
+
+/// Whether tasks are queued or running. Once false, the worker's changes to
+/// the map are visible to the caller.
+bool WorkerBusy(void);
+
+/// Wait until the worker is done or `timeout` ms have passed.
+void WaitForWorker(int timeout);
+
+#endif /* worker_h */